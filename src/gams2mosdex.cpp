@@ -1,22 +1,320 @@
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <climits>
+#include <cstdint>
 #include <iostream>
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <string>
+#include <tuple>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define RAPIDJSON_HAS_STDSTRING 1
 #include "rapidjson/prettywriter.h"
 #include "rapidjson/stringbuffer.h"
+#include "rapidjson/reader.h"
 
 #include "gmomcc.h"
 #include "gevmcc.h"
 #include "dctmcc.h"
 
 #include "loadgms.h"
+#include "mosdexio.h"
+#include "mosdexbin.h"
+#include "mosdexcache.h"
+
+typedef rapidjson::PrettyWriter<MosdexOutputStream> MosdexWriter;
+
+// converter options, set from command line
+class Options
+{
+public:
+   // print DATA tables column-wise instead of as arrays of row objects
+   bool columnar = false;
+
+   // in columnar layout, encode UEL columns as indices into a per-table dictionary
+   bool dictionary = false;
+
+   // output file, stdout if NULL
+   const char* outfile = NULL;
+
+   // compression of output, derived from name of output file if not given
+   Compression compression = COMPRESSION_NONE;
+   bool compressionset = false;
+
+   // write DATA tables into a binary file next to the output file, see mosdexbin.h
+   bool binary = false;
+
+   // write byte offsets of sections and DATA tables into a file next to the output file
+   bool index = false;
+
+   // write DATA tables into JSON-Lines files next to the output file
+   bool shards = false;
+
+   // maximal number of rows per JSON-Lines file, 0 for one file per table
+   size_t chunk = 0;
+
+   // write a content hash for each DATA table into HASHES
+   bool hashes = false;
+
+   // previous export: DATA tables with the same hash as there are written as references to it
+   const char* base = NULL;
+
+   // directory of previous conversions, and the size in bytes it may take up
+   const char* cache = NULL;
+   uint64_t cachesize = (uint64_t)1 << 30;
+
+   // report time and peak resident memory after each phase to stderr
+   bool stats = false;
+
+   // build DATA tables on one thread and write output on another, while the main thread prints
+   bool pipeline = false;
+
+   // write levels, marginals, and basis status of variables and equations into OUTPUT_DATA
+   bool solution = false;
+
+   // keep gmo while writing and print coefficient tables straight from its Jacobian, without collecting the coefficients
+   bool lowmem = false;
+
+   // file for the sections that do not change with the data; the output then has PROBLEM, DATA, and OUTPUT_DATA only
+   const char* structure = NULL;
+
+   // order rows of variable and equation tables and entries of coefficient blocks by their UEL tuples, see sortModel
+   bool sorted = false;
+};
+
+static Options options;
+
+// whether writing a file other than the output failed
+static bool writeerror = false;
+
+// binary DATA file, if options.binary
+static MosdexBinaryWriter binarydata;
+
+// byte offsets of the top-level sections and of the DATA tables in the output, for options.index
+// an offset pair gives the position right after the key of a member and the position after its value
+class OutputIndex
+{
+public:
+   // stream whose positions are recorded, NULL if no index is written
+   const MosdexOutputStream* os = NULL;
+
+   typedef std::vector<std::tuple<std::string, size_t, size_t> > Entries;
+   Entries sections;
+   Entries tables;
+
+   // to be called right after the key of a section or DATA table has been written
+   void begin(
+      Entries&           entries,
+      const std::string& name
+      )
+   {
+      if( os != NULL )
+         entries.push_back(std::make_tuple(name, os->Tell(), (size_t)0));
+   }
+
+   // to be called right after the value of a section or DATA table has been written
+   void end(
+      Entries& entries
+      )
+   {
+      if( os != NULL )
+         std::get<2>(entries.back()) = os->Tell();
+   }
+
+   // writes { "FILE_SIZE": n, "SECTIONS": { name: [ begin, end ] }, "DATA": { name: [ begin, end ] } }
+   bool write(
+      const char* filename
+      ) const
+   {
+      MosdexOutputStream ios;
+      if( !ios.open(filename, COMPRESSION_NONE) )
+         return false;
+
+      rapidjson::PrettyWriter<MosdexOutputStream> w(ios);
+      w.SetFormatOptions(rapidjson::kFormatSingleLineArray);
+      w.StartObject();
+
+      w.Key("FILE_SIZE");
+      w.Uint64(os->Tell());
+
+      w.Key("SECTIONS");
+      writeEntries(w, sections);
+
+      w.Key("DATA");
+      writeEntries(w, tables);
+
+      w.EndObject();
+      ios.Put('\n');
+
+      return ios.close();
+   }
+
+private:
+   static void writeEntries(
+      rapidjson::PrettyWriter<MosdexOutputStream>& w,
+      const Entries& entries
+      )
+   {
+      w.StartObject();
+      for( auto& e : entries )
+      {
+         w.Key(std::get<0>(e));
+         w.StartArray();
+         w.Uint64(std::get<1>(e));
+         w.Uint64(std::get<2>(e));
+         w.EndArray();
+      }
+      w.EndObject();
+   }
+};
+
+static OutputIndex outindex;
+
+// marks a value that is not given for a row of a DATA table
+static const double NOVALUE = std::numeric_limits<double>::quiet_NaN();
+
+static const std::chrono::steady_clock::time_point starttime = std::chrono::steady_clock::now();
+
+// prints time since start and peak resident memory so far, if options.stats
+static
+void reportStats(
+   const char* phase
+   )
+{
+   if( !options.stats )
+      return;
+
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count();
+
+   // ru_maxrss is in kilobytes on Linux
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+
+   std::cerr << "after " << phase << ": " << seconds << "s, peak RSS " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+}
+
+// content hashes of the DATA tables written, and of the DATA tables of options.base
+static std::map<std::string, std::string> tablehashes;
+static std::map<std::string, std::string> basehashes;
+
+// a file given on the command line as readers find it: relative to the directory of the output, like its companion
+// files; a file outside that directory is given by absolute path
+static
+std::string pathFromOutput(
+   const std::string& path
+   )
+{
+   if( path.empty() || path[0] == '/' || options.outfile == NULL )
+      return path;
+
+   std::string outfile(options.outfile);
+   std::string dir = outfile.substr(0, outfile.find_last_of('/') + 1);
+   if( dir.empty() )
+      return path;
+   if( path.compare(0, dir.size(), dir) == 0 )
+      return path.substr(dir.size());
+
+   char cwd[PATH_MAX];
+   if( getcwd(cwd, sizeof(cwd)) == NULL )
+      return path;
+   return std::string(cwd) + "/" + path;
+}
+
+// what the output needs from gmo and dct, copied so that both can be freed before writing, see extractModel
+// rows and columns are indexed by dct (model) index
+class Model
+{
+public:
+   std::string name;
+   int sense = gmoObj_Min;
+   double minf = -std::numeric_limits<double>::infinity();
+   double pinf = std::numeric_limits<double>::infinity();
+
+   // labels of UELs, by dct UEL index
+   std::vector<std::string> uellabels;
+
+   // rows and columns of a symbol are consecutive in dct and have the same dimension,
+   // so their UEL indices are found from the block of the symbol
+   class Block
+   {
+   public:
+      size_t start = 0;   // position of UEL indices of first row or column
+      int offset = -1;    // dct index of first row or column, -1 if not seen yet
+      int dim = 0;
+   };
+
+   // UEL indices of all rows and columns, stored one after another, the symbol of each row and column,
+   // and the block of each symbol (by dct symbol index); only the positions need 64 bits
+   std::vector<int> rowuels;
+   std::vector<int> rowsym;
+   std::vector<int> coluels;
+   std::vector<int> colsym;
+   std::vector<Block> blocks;
+
+   // bounds and type of columns and right-hand side and type of rows, for symbols that are in the model only
+   std::vector<double> lb;
+   std::vector<double> ub;
+   std::vector<int> vartype;
+   std::vector<double> rhs;
+   std::vector<int> equtype;
+
+   // levels, marginals, and basis status of columns and rows, if options.solution
+   std::vector<double> varlevel;
+   std::vector<double> varmarginal;
+   std::vector<int> varbasis;
+   std::vector<double> equlevel;
+   std::vector<double> equmarginal;
+   std::vector<int> equbasis;
+
+   const std::string& uelLabel(
+      int uel
+      ) const
+   {
+      return uellabels[uel];
+   }
+
+   // UEL indices of a row or column, NULL for an index that dct does not know (e.g., the objective row)
+   const int* rowUels(
+      int i
+      ) const
+   {
+      if( i < 0 || i >= (int)rowsym.size() )
+         return NULL;
+      const Block& b = blocks[rowsym[i]];
+      return rowuels.data() + b.start + (size_t)(i - b.offset) * b.dim;
+   }
+
+   const int* colUels(
+      int j
+      ) const
+   {
+      if( j < 0 || j >= (int)colsym.size() )
+         return NULL;
+      const Block& b = blocks[colsym[j]];
+      return coluels.data() + b.start + (size_t)(j - b.offset) * b.dim;
+   }
+};
+
+static Model model;
 
 class Domain
 {
@@ -53,26 +351,535 @@ public:
    // index of symbol in GAMS dct
    int symIdx;
 
+   // dct index of first row or column and number of rows or columns, for variables and equations
+   int offset = 0;
+   int entries = 0;
+
    std::string text;
    std::vector<Domain*> dom;
 
+   // names of the domains as key columns, see getDomName
+   std::vector<std::string> domnames;
+
+   // dct indices of the rows or columns in the order of the tables, if sorted, see sortModel
+   std::vector<int> order;
+
    Type type;
 
-   int dim()
+   int dim() const
    {
       return (int)dom.size();
    }
 
-   std::string getDomName(
+   // dct index of the k-th row or column in the tables of the symbol
+   int index(
+      int k
+      ) const
+   {
+      return order.empty() ? offset + k : order[k];
+   }
+
+   const std::string& getDomName(
       int pos
-      )
+      ) const
    {
-      return dom.at(pos)->name + '#' + name;
+      return domnames.at(pos);
    }
 };
 
 
 
+// a string as quoted and escaped JSON, to be written with RawValue
+static
+std::string jsonString(
+   const std::string& str
+   )
+{
+   rapidjson::StringBuffer buffer;
+   rapidjson::Writer<rapidjson::StringBuffer> sw(buffer);
+   sw.String(str);
+   return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+// order of n tuples of nkeys UEL indices (less than nuels), stored one after another, lexicographically by UEL index
+// a least significant digit radix sort: a stable counting pass for each 16 bits of UEL index, last key column first
+static
+std::vector<size_t> sortTuples(
+   const int* uels,
+   size_t     n,
+   size_t     nkeys,
+   size_t     nuels
+   )
+{
+   std::vector<size_t> perm(n);
+   for( size_t r = 0; r < n; ++r )
+      perm[r] = r;
+
+   // small tables do not pay for the counts
+   if( n < 256 )
+   {
+      std::stable_sort(perm.begin(), perm.end(), [&](size_t a, size_t b)
+         {
+            return std::lexicographical_compare(uels + a * nkeys, uels + (a+1) * nkeys, uels + b * nkeys, uels + (b+1) * nkeys);
+         });
+      return perm;
+   }
+
+   int ndigits = 0;
+   for( size_t u = nuels; u > 0; u >>= 16 )
+      ++ndigits;
+
+   std::vector<size_t> count(1 << 16);
+   std::vector<size_t> tmp(n);
+   for( size_t k = nkeys; k-- > 0; )
+      for( int digit = 0; digit < ndigits; ++digit )
+      {
+         int shift = 16 * digit;
+         auto bucket = [&](size_t r) { return ((uint32_t)uels[r * nkeys + k] >> shift) & 0xffff; };
+
+         std::fill(count.begin(), count.end(), 0);
+         for( size_t r = 0; r < n; ++r )
+            ++count[bucket(r)];
+
+         // a pass that puts all tuples into one bucket keeps the order
+         if( count[bucket(0)] == n )
+            continue;
+
+         size_t pos = 0;
+         for( auto& c : count )
+         {
+            size_t c0 = c;
+            c = pos;
+            pos += c0;
+         }
+         for( size_t r : perm )
+            tmp[count[bucket(r)]++] = r;
+         perm.swap(tmp);
+      }
+
+   return perm;
+}
+
+// rows of a DATA table, collected so that they can be printed row- or column-wise
+class DataTable
+{
+public:
+   // name of the table in DATA
+   std::string name;
+
+   // names of key columns (UEL valued) and of value columns (double valued)
+   std::vector<std::string> keys;
+   std::vector<std::string> values;
+
+   // UEL indices of key columns and values of value columns, stored row after row
+   // a value is NOVALUE if it is not given for the row
+   std::vector<int> uels;
+   std::vector<double> vals;
+
+   size_t nrows = 0;
+
+   // names of key and value columns as quoted and escaped JSON strings, made once per table, see encodeNames
+   std::vector<std::string> keysjson;
+   std::vector<std::string> valuesjson;
+
+   void addRow(
+      const int*    rowuels,
+      const double* rowvals
+      )
+   {
+      uels.insert(uels.end(), rowuels, rowuels + keys.size());
+      vals.insert(vals.end(), rowvals, rowvals + values.size());
+      ++nrows;
+   }
+
+   // rows, ordered by their key tuples, see sortTuples
+   std::vector<size_t> sortedRows() const
+   {
+      return sortTuples(uels.data(), nrows, keys.size(), model.uellabels.size());
+   }
+
+   // hash of names of columns and of rows, with key columns by label, in the order of rows
+   // layout identifies how the table is printed, so that a reader can take the table from an export with the same hash
+   std::string hashContent(
+      const std::string& layout
+      ) const
+   {
+      ContentHash h;
+
+      h.add(layout);
+      for( auto& k : keys )
+         h.add(k);
+      h.add("");
+      for( auto& v : values )
+         h.add(v);
+      h.add("");
+
+      for( size_t r = 0; r < nrows; ++r )
+      {
+         for( size_t k = 0; k < keys.size(); ++k )
+            h.add(model.uelLabel(uels[r * keys.size() + k]));
+         for( size_t v = 0; v < values.size(); ++v )
+         {
+            // all missing values hash the same, whatever NaN they are
+            double val = std::isnan(vals[r * values.size() + v]) ? NOVALUE : vals[r * values.size() + v];
+            h.add(&val, sizeof(val));
+         }
+      }
+
+      return h.hex();
+   }
+
+   // layout that print uses, see hashContent
+   static std::string layoutName()
+   {
+      if( options.binary )
+         return "BINARY";
+      if( options.shards )
+         return "SHARDED";
+      if( options.columnar )
+         return options.dictionary ? "DICTIONARY" : "COLUMNAR";
+      return "ROWS";
+   }
+
+   void print(
+      MosdexWriter& w
+      )
+   {
+      if( options.binary )
+         printBinary(w);
+      else if( options.shards )
+         printShards(w);
+      else if( options.columnar )
+         printColumns(w);
+      else
+         printRows(w);
+   }
+
+   // prints { "LAYOUT": "DENSE", "AXES": { key: [ ... ] }, value: [ ... ] }
+   // with the values row-major over the product of the axes (last key runs fastest), see Coefficient::isDense
+   void printDense(
+      MosdexWriter& w
+      )
+   {
+      // position of each UEL on the axis of a key column, axes ordered by UEL index
+      std::vector<std::map<int, size_t> > axes(keys.size());
+      for( size_t r = 0; r < nrows; ++r )
+         for( size_t k = 0; k < keys.size(); ++k )
+            axes[k][uels[r * keys.size() + k]] = 0;
+      for( auto& axis : axes )
+      {
+         size_t i = 0;
+         for( auto& a : axis )
+            a.second = i++;
+      }
+
+      std::vector<size_t> pos(nrows);
+      for( size_t r = 0; r < nrows; ++r )
+      {
+         pos[r] = 0;
+         for( size_t k = 0; k < keys.size(); ++k )
+            pos[r] = pos[r] * axes[k].size() + axes[k][uels[r * keys.size() + k]];
+      }
+
+      w.StartObject();
+
+      w.Key("LAYOUT");
+      w.String("DENSE");
+
+      w.Key("AXES");
+      w.StartObject();
+      for( size_t k = 0; k < keys.size(); ++k )
+      {
+         w.Key(keys[k]);
+         w.StartArray();
+         for( auto& a : axes[k] )
+            w.String(model.uelLabel(a.first));
+         w.EndArray();
+      }
+      w.EndObject();
+
+      std::vector<double> dense(nrows);
+      for( size_t v = 0; v < values.size(); ++v )
+      {
+         for( size_t r = 0; r < nrows; ++r )
+            dense[pos[r]] = vals[r * values.size() + v];
+
+         w.Key(values[v]);
+         w.StartArray();
+         for( double val : dense )
+         {
+            if( std::isnan(val) )
+               w.Null();
+            else
+               w.Double(val);
+         }
+         w.EndArray();
+      }
+
+      w.EndObject();
+   }
+
+   // prints { "LAYOUT": "PATTERN", "PATTERN": name, value: [ ... ] }
+   // with the values in the order of the rows of the table that is printed under the given name
+   // rows and patternrows are the rows of both tables ordered by key tuple, so the i-th of each have the same keys
+   void printPattern(
+      MosdexWriter&              w,
+      const std::string&         patname,
+      const std::vector<size_t>& rows,
+      const std::vector<size_t>& patternrows
+      )
+   {
+      assert(rows.size() == nrows && patternrows.size() == nrows);
+
+      // row with the same keys as each row of the pattern
+      std::vector<size_t> at(nrows);
+      for( size_t i = 0; i < nrows; ++i )
+         at[patternrows[i]] = rows[i];
+
+      w.StartObject();
+
+      w.Key("LAYOUT");
+      w.String("PATTERN");
+
+      w.Key("PATTERN");
+      w.String(patname);
+
+      for( size_t v = 0; v < values.size(); ++v )
+      {
+         w.Key(values[v]);
+         w.StartArray();
+         for( size_t p = 0; p < nrows; ++p )
+         {
+            double val = vals[at[p] * values.size() + v];
+            if( std::isnan(val) )
+               w.Null();
+            else
+               w.Double(val);
+         }
+         w.EndArray();
+      }
+
+      w.EndObject();
+   }
+
+private:
+   // writes the table to the binary DATA file and prints { "LAYOUT": "BINARY", "TABLE": t, "VALUES": [ ... ] }
+   // key columns are in the order of the INPUT_DATA_MODEL, value columns in the order given
+   void printBinary(
+      MosdexWriter& w
+      )
+   {
+      uint32_t t = binarydata.writeTable(nrows, keys.size(), uels.data(), values.size(), vals.data());
+
+      w.StartObject();
+
+      w.Key("LAYOUT");
+      w.String("BINARY");
+
+      w.Key("TABLE");
+      w.Uint(t);
+
+      w.Key("VALUES");
+      w.StartArray();
+      for( auto& v : values )
+         w.String(v);
+      w.EndArray();
+
+      w.EndObject();
+   }
+
+   // escapes the column names for printRow, so that a row is printed without escaping or allocating them again
+   void encodeNames()
+   {
+      keysjson.clear();
+      for( auto& k : keys )
+         keysjson.push_back(jsonString(k));
+      valuesjson.clear();
+      for( auto& v : values )
+         valuesjson.push_back(jsonString(v));
+   }
+
+   // prints a row as object { key: label, ..., value: val, ... }, skipping values that are not given
+   // column names are written as the raw fragments from encodeNames
+   template<typename Writer>
+   void printRow(
+      Writer&     w,
+      size_t      r
+      )
+   {
+      assert(keysjson.size() == keys.size() && valuesjson.size() == values.size());
+
+      w.StartObject();
+      for( size_t k = 0; k < keys.size(); ++k )
+      {
+         w.RawValue(keysjson[k].data(), keysjson[k].size(), rapidjson::kStringType);
+         w.String(model.uelLabel(uels[r * keys.size() + k]));
+      }
+      for( size_t v = 0; v < values.size(); ++v )
+      {
+         double val = vals[r * values.size() + v];
+         if( std::isnan(val) )
+            continue;
+
+         w.RawValue(valuesjson[v].data(), valuesjson[v].size(), rapidjson::kStringType);
+         w.Double(val);
+      }
+      w.EndObject();
+   }
+
+   void printRows(
+      MosdexWriter& w
+      )
+   {
+      encodeNames();
+
+      w.StartArray();
+      for( size_t r = 0; r < nrows; ++r )
+         printRow(w, r);
+      w.EndArray();
+   }
+
+   // writes the rows as JSON-Lines into files <outfile>.<table>.<k>.jsonl, options.chunk rows per file (all if 0),
+   // compressed like the output file, and prints { "LAYOUT": "SHARDED", "ROWS": n, "SHARDS": [ file, ... ] }
+   // with files relative to the directory of the output file
+   void printShards(
+      MosdexWriter& w
+      )
+   {
+      std::string suffix = ".jsonl";
+      if( options.compression == COMPRESSION_GZIP )
+         suffix += ".gz";
+      else if( options.compression == COMPRESSION_ZSTD )
+         suffix += ".zst";
+
+      std::string outfile(options.outfile);
+      std::string dir = outfile.substr(0, outfile.find_last_of('/') + 1);
+
+      size_t chunk = options.chunk > 0 ? options.chunk : std::max(nrows, (size_t)1);
+
+      encodeNames();
+
+      w.StartObject();
+
+      w.Key("LAYOUT");
+      w.String("SHARDED");
+
+      w.Key("ROWS");
+      w.Uint64(nrows);
+
+      w.Key("SHARDS");
+      w.StartArray();
+      for( size_t first = 0, k = 0; first < nrows || k == 0; first += chunk, ++k )
+      {
+         std::string shardfile = outfile + "." + name + "." + std::to_string(k) + suffix;
+         w.String(shardfile.substr(dir.size()));
+
+         MosdexOutputStream os;
+         if( !os.open(shardfile.c_str(), options.compression) )
+         {
+            writeerror = true;
+            continue;
+         }
+
+         rapidjson::Writer<MosdexOutputStream> sw(os);
+         for( size_t r = first; r < std::min(first + chunk, nrows); ++r )
+         {
+            sw.Reset(os);
+            printRow(sw, r);
+            os.Put('\n');
+         }
+
+         if( !os.close() )
+            writeerror = true;
+      }
+      w.EndArray();
+
+      w.EndObject();
+   }
+
+   // prints { "ROWS": n, "COLUMNS": { col: [ ... ], ... }, "DICTIONARY": [ ... ] }
+   // a value column is omitted if no row has a value, otherwise missing values are null
+   void printColumns(
+      MosdexWriter& w
+      )
+   {
+      // dictionary code of each UEL, in order of first appearance
+      std::map<int, int> uelcode;
+      std::vector<int> dict;
+      if( options.dictionary )
+      {
+         for( int u : uels )
+         {
+            if( uelcode.count(u) == 0 )
+            {
+               uelcode[u] = (int)dict.size();
+               dict.push_back(u);
+            }
+         }
+      }
+
+      w.StartObject();
+
+      w.Key("ROWS");
+      w.Uint64(nrows);
+
+      w.Key("COLUMNS");
+      w.StartObject();
+      for( size_t k = 0; k < keys.size(); ++k )
+      {
+         w.Key(keys[k]);
+         w.StartArray();
+         for( size_t r = 0; r < nrows; ++r )
+         {
+            int u = uels[r * keys.size() + k];
+            if( options.dictionary )
+            {
+               w.Int(uelcode[u]);
+               continue;
+            }
+            w.String(model.uelLabel(u));
+         }
+         w.EndArray();
+      }
+
+      for( size_t v = 0; v < values.size(); ++v )
+      {
+         bool hasvalue = false;
+         for( size_t r = 0; r < nrows && !hasvalue; ++r )
+            hasvalue = !std::isnan(vals[r * values.size() + v]);
+         if( !hasvalue )
+            continue;
+
+         w.Key(values[v]);
+         w.StartArray();
+         for( size_t r = 0; r < nrows; ++r )
+         {
+            double val = vals[r * values.size() + v];
+            if( std::isnan(val) )
+               w.Null();
+            else
+               w.Double(val);
+         }
+         w.EndArray();
+      }
+      w.EndObject();
+
+      if( options.dictionary )
+      {
+         w.Key("DICTIONARY");
+         w.StartArray();
+         for( int u : dict )
+            w.String(model.uelLabel(u));
+         w.EndArray();
+      }
+
+      w.EndObject();
+   }
+};
+
+// gmo, if options.lowmem, from which coefficient tables are printed
+static gmoHandle_t jacgmo = NULL;
+
 // a block of coefficients
 class Coefficient
 {
@@ -88,64 +895,394 @@ public:
    {
       for( int i = 0; i < var.dim(); ++i )
          varDomEqualsEquDom[i] = -1;
+
+      // performance of this might be slow (though at most 20x20)
+      for( int c = 0; c < var.dim(); ++c )
+         for( int r = 0; r < equ.dim(); ++r )
+            if( equ.dom[r] == var.dom[c] )
+               domainpairs.push_back(std::make_pair(c, r));
    }
 
-   void analyzeDomains(dctHandle_t dct)
+   // adds an entry by dct row and column index, keeping track of what analyzeDomains and analyzeValues need,
+   // so that the entry itself only needs to be stored if keep
+   void addEntry(
+      int    i,
+      int    j,
+      double val,
+      bool   keep
+      )
    {
-      std::vector<Domain*>& equDom(equation.dom);
-      std::vector<Domain*>& varDom(variable.dom);
+      if( keep )
+         entries.push_back(std::tuple<int, int, double>(i, j, val));
+
+      if( nentries == 0 )
+         firstvalue = val;
+      else if( val != firstvalue )
+         samevalue = false;
+      ++nentries;
+
+      if( domainpairs.empty() )
+         return;
+
+      const int* rowUels = model.rowUels(i);
+      const int* colUels = model.colUels(j);
+      domainpairs.erase(std::remove_if(domainpairs.begin(), domainpairs.end(),
+         [&](const std::pair<int, int>& p) { return rowUels[p.second] != colUels[p.first]; }), domainpairs.end());
+   }
 
-      // performance of this might be slow (though at most 20x20)
-      for( size_t c = 0; c < equDom.size(); ++c )
+   // each variable domain equals the first equation domain that has the same UEL in all entries, see addEntry
+   void analyzeDomains()
+   {
+      // which domains are equal depends on the data, so with options.structure no block gets a CONDITION
+      if( options.structure != NULL )
+         return;
+
+      for( auto& p : domainpairs )
+         if( varDomEqualsEquDom[p.first] < 0 )
+            varDomEqualsEquDom[p.first] = p.second;
+   }
+
+   // checks whether the block can be written as a single value with a CONDITION:
+   // all entries have the same value, every variable domain equals an equation domain,
+   // so each equation row has at most one entry, and every equation row has an entry
+   void analyzeValues()
+   {
+      scalar = false;
+
+      // the value would be part of the structure, which has to stay the same for all data
+      if( nentries == 0 || options.structure != NULL )
+         return;
+
+      for( int d = 0; d < variable.dim(); ++d )
+         if( varDomEqualsEquDom[d] < 0 )
+            return;
+
+      // the objective is made up and has a single row only
+      size_t nrows = equation.type == Symbol::Objective ? 1 : (size_t)equation.entries;
+      if( nentries != nrows || !samevalue )
+         return;
+
+      scalar = true;
+   }
+
+   // classifies the sparsity structure of the block, see Structure, and hashes its key tuples for analyzePatterns
+   void analyzeStructure()
+   {
+      structure = EqualityConditioned;
+      for( int d = 0; d < variable.dim(); ++d )
+         if( varDomEqualsEquDom[d] < 0 )
+            structure = Subset;
+
+      // with options.lowmem, the entries are not at hand to check for dense and repeated key tuples
+      if( scalar || options.lowmem || entries.empty() )
+         return;
+
+      size_t nkeys = getKeys().size();
+      std::vector<int> keyuels;
+      keyuels.reserve(entries.size() * nkeys);
+      forEachRow([&](const int* keyUels, double) { keyuels.insert(keyuels.end(), keyUels, keyUels + nkeys); });
+
+      // FNV-1a over the sorted tuples, independent of the order of entries; sortedrows is kept for analyzePatterns
+      sortedrows = sortTuples(keyuels.data(), entries.size(), nkeys, model.uellabels.size());
+      uint64_t h = 14695981039346656037ULL;
+      for( size_t r : sortedrows )
+         for( size_t k = 0; k < nkeys; ++k )
+         {
+            h ^= (uint32_t)keyuels[r * nkeys + k];
+            h *= 1099511628211ULL;
+         }
+      patternHash = h;
+
+      // with a single key column, every block is all combinations of its UELs
+      if( structure == Subset && nkeys >= 2 && isDense(keyuels, nkeys) )
+         structure = Dense;
+   }
+
+   // whether the entries, with their key tuples in keyuels, are all combinations of the UELs in each key column
+   // (entries have distinct key tuples)
+   bool isDense(
+      const std::vector<int>& keyuels,
+      size_t                  nkeys
+      ) const
+   {
+      size_t ncombinations = 1;
+      std::vector<int> axis(entries.size());
+      for( size_t k = 0; k < nkeys && ncombinations <= entries.size(); ++k )
       {
-         for( size_t r = 0; r < varDom.size() && varDomEqualsEquDom[c] < 0; ++r )
+         for( size_t r = 0; r < entries.size(); ++r )
+            axis[r] = keyuels[r * nkeys + k];
+         std::sort(axis.begin(), axis.end());
+         ncombinations *= std::unique(axis.begin(), axis.end()) - axis.begin();
+      }
+      return ncombinations == entries.size();
+   }
+
+   // key columns of the DATA table of the block: equation domains and variable domains that are not conditioned
+   std::vector<std::string> getKeys() const
+   {
+      std::vector<std::string> keys;
+      for( int d = 0; d < equation.dim(); ++d )
+         keys.push_back(equation.getDomName(d));
+      for( int d = 0; d < variable.dim(); ++d )
+         if( varDomEqualsEquDom[d] < 0 )
+            keys.push_back(variable.getDomName(d));
+      return keys;
+   }
+
+   // UELs of the key columns of the entry in row i and column j, see getKeys; returns their number
+   int getKeyUels(
+      int  i,
+      int  j,
+      int* keyUels
+      ) const
+   {
+      const int* rowUels = model.rowUels(i);
+      const int* colUels = model.colUels(j);
+
+      int nkeys = 0;
+      for( int d = 0; d < equation.dim(); ++d )
+         keyUels[nkeys++] = rowUels[d];
+
+      for( int d = 0; d < variable.dim(); ++d )
+         if( varDomEqualsEquDom[d] < 0 )
+            keyUels[nkeys++] = colUels[d];
+
+      return nkeys;
+   }
+
+   // calls f with the UELs of the key columns and the value of each entry
+   // entries are taken from jacgmo if they were not kept, going through the columns of the variable,
+   // which are consecutive, and skipping the rows of other equations
+   void forEachRow(
+      const std::function<void(const int*, double)>& f
+      ) const
+   {
+      int keyUels[2 * GMS_MAX_INDEX_DIM];
+
+      auto row = [&](int i, int j, double val)
+      {
+         getKeyUels(i, j, keyUels);
+         f(keyUels, val);
+      };
+
+      if( jacgmo == NULL || !entries.empty() )
+      {
+         for( auto& e : entries )
+            row(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+         return;
+      }
+
+      double jacval;
+      int rowidx;
+      int nlflag;
+      for( int idx = variable.offset; idx < variable.offset + variable.entries; ++idx )
+      {
+         int j = gmoGetjSolver(jacgmo, idx);
+         if( j < 0 )
+            continue;
+
+         void* jacptr = NULL;
+         gmoGetColJacInfoOne(jacgmo, j, &jacptr, &jacval, &rowidx, &nlflag);
+         while( jacptr != NULL )
          {
-            if( equDom[r] != varDom[c] )
-               continue;
+            int i = gmoGetiModel(jacgmo, rowidx);
+            if( model.rowsym[i] == equation.symIdx )
+               row(i, idx, jacval);
 
-            // std::cout << "compare rowsymbol " << rowSymIdx << " colsymbol " << colSymIdx << " coldim " << c << " rowdim " << r << std::endl;
+            gmoGetColJacInfoOne(jacgmo, j, &jacptr, &jacval, &rowidx, &nlflag);
+         }
+      }
+   }
 
-            bool uelsequal = true;
-            for( auto& e : entries )
-            {
-               int rowUels[GMS_MAX_INDEX_DIM];
-               int colUels[GMS_MAX_INDEX_DIM];
-               int symindex;
-               int dim;
+   // orders the kept entries by the key tuples of their DATA table rows, see sortTuples
+   // the key columns depend on which variable domains are conditioned, so analyzeDomains has to come first
+   void sortEntries()
+   {
+      size_t nkeys = getKeys().size();
+      std::vector<int> keyuels;
+      keyuels.reserve(entries.size() * nkeys);
+      forEachRow([&](const int* keyUels, double) { keyuels.insert(keyuels.end(), keyUels, keyUels + nkeys); });
+
+      std::vector<std::tuple<int, int, double> > sorted;
+      sorted.reserve(entries.size());
+      for( size_t r : sortTuples(keyuels.data(), entries.size(), nkeys, model.uellabels.size()) )
+         sorted.push_back(entries[r]);
+      entries.swap(sorted);
+   }
 
-               dctRowUels(dct, std::get<0>(e), &symindex, rowUels, &dim);
-               dctColUels(dct, std::get<1>(e), &symindex, colUels, &dim);
+   // computes sortedrows once, from the kept entries
+   void sortRows()
+   {
+      if( !sortedrows.empty() || entries.empty() )
+         return;
+
+      size_t nkeys = getKeys().size();
+      std::vector<int> keyuels;
+      keyuels.reserve(entries.size() * nkeys);
+      forEachRow([&](const int* keyUels, double) { keyuels.insert(keyuels.end(), keyUels, keyUels + nkeys); });
+      sortedrows = sortTuples(keyuels.data(), entries.size(), nkeys, model.uellabels.size());
+   }
 
-#if 0
-               char uelLabel[GMS_SSSIZE];
-               uelLabel[0] = '\0';
-               dctUelLabel(dct, rowUels[r], uelLabel, uelLabel, sizeof(uelLabel));
-               // std::cout << "  row: " << rowUels[r] << ' ' << uelLabel;
-               uelLabel[0] = '\0';
-               dctUelLabel(dct, colUels[c], uelLabel, uelLabel, sizeof(uelLabel));
-               // std::cout << "  col: " << colUels[c] << ' ' << uelLabel << std::endl;
-#endif
+   // whether both blocks have the same set of key tuples, comparing them in sorted order straight from the entries
+   bool sameKeys(
+      Coefficient& other
+      )
+   {
+      if( nentries != other.nentries || getKeys().size() != other.getKeys().size() )
+         return false;
+
+      sortRows();
+      other.sortRows();
+
+      int keyUels[2 * GMS_MAX_INDEX_DIM];
+      int otherKeyUels[2 * GMS_MAX_INDEX_DIM];
+      for( size_t r = 0; r < entries.size(); ++r )
+      {
+         const std::tuple<int, int, double>& e = entries[sortedrows[r]];
+         const std::tuple<int, int, double>& o = other.entries[other.sortedrows[r]];
+         int nkeys = getKeyUels(std::get<0>(e), std::get<1>(e), keyUels);
+         other.getKeyUels(std::get<0>(o), std::get<1>(o), otherKeyUels);
+         if( !std::equal(keyUels, keyUels + nkeys, otherKeyUels) )
+            return false;
+      }
+      return true;
+   }
+
+   // the DATA table of the block: getKeys as keys, "val" as value
+   DataTable getTable() const
+   {
+      DataTable table;
+      table.name = getName();
+      table.keys = getKeys();
+      table.values.push_back("val");
+
+      forEachRow([&table](const int* keyUels, double val) { table.addRow(keyUels, &val); });
+
+      return table;
+   }
 
-               if( rowUels[r] != colUels[c] )
+   // prints the DATA table of the block as DataTable::print would in row or columnar layout,
+   // one row at a time from forEachRow, so the table is never held in memory
+   void printStreamed(
+      MosdexWriter& w
+      ) const
+   {
+      std::vector<std::string> keys = getKeys();
+      std::vector<std::string> keysjson;
+      for( auto& k : keys )
+         keysjson.push_back(jsonString(k));
+      std::string valjson = jsonString("val");
+
+      if( !options.columnar )
+      {
+         w.StartArray();
+         forEachRow([&](const int* keyUels, double val)
+            {
+               w.StartObject();
+               for( size_t k = 0; k < keys.size(); ++k )
                {
-                  uelsequal = false;
-                  break;
+                  w.RawValue(keysjson[k].data(), keysjson[k].size(), rapidjson::kStringType);
+                  w.String(model.uelLabel(keyUels[k]));
                }
-            }
+               w.RawValue(valjson.data(), valjson.size(), rapidjson::kStringType);
+               w.Double(val);
+               w.EndObject();
+            });
+         w.EndArray();
+         return;
+      }
 
-            if( uelsequal )
-               varDomEqualsEquDom[c] = r;
-         }
+      // dictionary code of each UEL, in order of first appearance, as in DataTable::printColumns
+      std::map<int, int> uelcode;
+      std::vector<int> dict;
+      if( options.dictionary )
+      {
+         forEachRow([&](const int* keyUels, double)
+            {
+               for( size_t k = 0; k < keys.size(); ++k )
+                  if( uelcode.count(keyUels[k]) == 0 )
+                  {
+                     uelcode[keyUels[k]] = (int)dict.size();
+                     dict.push_back(keyUels[k]);
+                  }
+            });
       }
+
+      w.StartObject();
+
+      w.Key("ROWS");
+      w.Uint64(nentries);
+
+      // one pass over the entries for each column
+      w.Key("COLUMNS");
+      w.StartObject();
+      for( size_t k = 0; k < keys.size(); ++k )
+      {
+         w.RawValue(keysjson[k].data(), keysjson[k].size(), rapidjson::kStringType);
+         w.StartArray();
+         forEachRow([&](const int* keyUels, double)
+            {
+               if( options.dictionary )
+                  w.Int(uelcode[keyUels[k]]);
+               else
+                  w.String(model.uelLabel(keyUels[k]));
+            });
+         w.EndArray();
+      }
+      w.RawValue(valjson.data(), valjson.size(), rapidjson::kStringType);
+      w.StartArray();
+      forEachRow([&](const int*, double val) { w.Double(val); });
+      w.EndArray();
+      w.EndObject();
+
+      if( options.dictionary )
+      {
+         w.Key("DICTIONARY");
+         w.StartArray();
+         for( int u : dict )
+            w.String(model.uelLabel(u));
+         w.EndArray();
+      }
+
+      w.EndObject();
    }
 
-   std::string getName()
+   std::string getName() const
    {
       return std::string("coef_") + equation.name + "_" + variable.name;
    }
 
-   // equation index, variable index, coefficient
+   // equation index, variable index, coefficient, unless only counted, see addEntry
    std::vector<std::tuple<int, int, double> > entries;
+
+   // number of entries, value of the first entry, and whether all entries have that value
+   size_t nentries = 0;
+   double firstvalue = 0.0;
+   bool samevalue = true;
+
+   // pairs of variable and equation domain that are the same domain and have had the same UEL in all entries so far
+   std::vector<std::pair<int, int> > domainpairs;
+
+   // whether all entries are given by the value of the first entry and the CONDITION, see analyzeValues
+   bool scalar = false;
+
+   typedef enum {
+      Subset,                // explicit sparsity pattern
+      EqualityConditioned,   // every variable domain equals an equation domain
+      Dense                  // all combinations of the UELs that appear in the key columns
+   } Structure;
+
+   Structure structure = Subset;
+
+   // hash of the key tuples of the DATA table, if not dense or scalar
+   uint64_t patternHash = 0;
+
+   // earlier block with the same key tuples, whose DATA table rows are referenced instead of repeated, or NULL
+   const Coefficient* pattern = NULL;
+
+   // rows of the DATA table ordered by key tuple, for blocks that refer to a pattern or are referred to as one,
+   // see analyzePatterns
+   std::vector<size_t> sortedrows;
 };
 
 // variables and constraints, indexed by Dct symbol index
@@ -154,6 +1291,99 @@ std::vector<Symbol> symbols;
 // equation symbol index, variable symbol index
 std::map<std::pair<int, int>, Coefficient> coefs;
 
+// lets coefficient blocks with the same key tuples as an earlier block refer to its DATA table rows
+static
+void analyzePatterns()
+{
+   // blocks with a table of their own, by number of entries and hash of key tuples
+   std::map<std::pair<size_t, uint64_t>, std::vector<Coefficient*> > tables;
+
+   for( auto& cit : coefs )
+   {
+      Coefficient& c(cit.second);
+
+      if( c.scalar || c.structure == Coefficient::Dense )
+         continue;
+
+      std::vector<Coefficient*>& candidates(tables[std::make_pair(c.nentries, c.patternHash)]);
+      for( Coefficient* p : candidates )
+      {
+         if( p->sameKeys(c) )
+         {
+            c.pattern = p;
+            break;
+         }
+      }
+
+      if( c.pattern == NULL )
+         candidates.push_back(&c);
+   }
+
+   // the row orders are kept for printing pattern tables only
+   std::set<const Coefficient*> referenced;
+   for( auto& cit : coefs )
+      if( cit.second.pattern != NULL )
+         referenced.insert(cit.second.pattern);
+   for( auto& cit : coefs )
+      if( cit.second.pattern == NULL && referenced.count(&cit.second) == 0 )
+         std::vector<size_t>().swap(cit.second.sortedrows);
+}
+
+
+// orders the rows or columns of a variable or equation by their UEL tuples, see Symbol::index
+static
+void sortSymbol(
+   Symbol& e
+   )
+{
+   std::vector<int> tuples;
+   tuples.reserve((size_t)e.entries * e.dim());
+   for( int idx = e.offset; idx < e.offset + e.entries; ++idx )
+   {
+      const int* uels = e.type == Symbol::Variable ? model.colUels(idx) : model.rowUels(idx);
+      tuples.insert(tuples.end(), uels, uels + e.dim());
+   }
+
+   std::vector<size_t> perm = sortTuples(tuples.data(), (size_t)e.entries, (size_t)e.dim(), model.uellabels.size());
+   e.order.resize(perm.size());
+   for( size_t k = 0; k < perm.size(); ++k )
+      e.order[k] = e.offset + (int)perm[k];
+}
+
+// orders the tables of variables and equations and the entries of coefficient blocks by UEL tuple, so that the output
+// does not depend on the order in which GAMS generated rows and columns
+// symbols and blocks are sorted on all cores, largest first, each by one thread
+static
+void sortModel()
+{
+   std::vector<std::pair<size_t, std::function<void()> > > jobs;
+   for( auto& e : symbols )
+      if( e.dim() > 0 && (e.type == Symbol::Variable || e.type == Symbol::Constraint) )
+         jobs.push_back(std::make_pair((size_t)e.entries, [&e]() { sortSymbol(e); }));
+   for( auto& cit : coefs )
+   {
+      Coefficient& c = cit.second;
+      jobs.push_back(std::make_pair(c.entries.size(), [&c]() { c.sortEntries(); }));
+   }
+   std::sort(jobs.begin(), jobs.end(),
+      [](const std::pair<size_t, std::function<void()> >& a, const std::pair<size_t, std::function<void()> >& b) { return a.first > b.first; });
+
+   std::atomic<size_t> next(0);
+   auto worker = [&]()
+   {
+      for( size_t i = next++; i < jobs.size(); i = next++ )
+         jobs[i].second();
+   };
+
+   unsigned nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+   std::vector<std::thread> threads;
+   for( unsigned t = 1; t < nthreads && t < jobs.size(); ++t )
+      threads.push_back(std::thread(worker));
+   worker();
+   for( auto& t : threads )
+      t.join();
+}
+
 static
 void analyzeDict(
    gmoHandle_t gmo,
@@ -204,79 +1434,214 @@ void analyzeDict(
          type = Symbol::None;
       symbols.push_back(Symbol(symName, type, i));
       symbols.back().text = symText;
+      if( type != Symbol::None )
+      {
+         symbols.back().offset = dctSymOffset(dct, i);
+         symbols.back().entries = dctSymEntries(dct, i);
+      }
 
       dctSymDomIdx(dct, i, symDomIdx, &symDim);
       // std::cout << "Symbol " << i << " = " << symName << '(';
       for( int d = 0; d < symDim; ++d )
       {
-         //if( d > 0 )
-         //   std::cout << ",";
-         //std::cout << domains.at(symDomIdx[d]).name;
-         symbols.back().dom.push_back(&domains[symDomIdx[d]]);
+         //if( d > 0 )
+         //   std::cout << ",";
+         //std::cout << domains.at(symDomIdx[d]).name;
+         symbols.back().dom.push_back(&domains[symDomIdx[d]]);
+         symbols.back().domnames.push_back(domains[symDomIdx[d]].name + '#' + symName);
+      }
+      //std::cout << ") type " << symType << " dim " << symDim << " (" << symText << ")" << std::endl;
+
+      // check whether symbol is actually used in model
+      // if it was the original objective variable or objective constraint, then it could have been reformulated out, though it is still in dct
+      // thus, should be enough to do this for 0-dim symbols
+      if( symDim == 0 )
+      {
+         int idx = dctSymOffset(dct, i);
+         if( symType == dctvarSymType  )
+         {
+            // FIXME this prints a message if the var is the objective var that has been reformulated out, but then returns -2
+            idx = gmoGetjSolver(gmo, idx);
+            if( idx < 0 || idx >= gmoN(gmo) )
+               symbols.back().type = Symbol::None;
+         }
+         else if( symType == dcteqnSymType )
+         {
+            // FIXME this prints a message if the equ is the objective that has been reformulated out, but then returns -2
+            idx = gmoGetiSolver(gmo, idx);
+            if( idx < 0 || idx >= gmoM(gmo) )
+               symbols.back().type = Symbol::None;
+         }
+      }
+   }
+
+#if 0
+   for( int u = 0; u < dctNUels(dct); ++u )
+   {
+      char uelLabel[GMS_SSSIZE];
+      uelLabel[0] = '\0';
+      dctUelLabel(dct, u, uelLabel, uelLabel, sizeof(uelLabel));
+      std::cout << "UEL " << u << " = " << uelLabel << std::endl;
+   }
+#endif
+
+}
+
+// copies what the output needs from gmo and dct into model
+static
+void extractModel(
+   gmoHandle_t gmo,
+   dctHandle_t dct
+   )
+{
+   char buffer[GMS_SSSIZE];
+   int symIndex;
+   int uelIndices[GMS_MAX_INDEX_DIM];
+   int symDim;
+
+   gmoNameModel(gmo, buffer);
+   model.name = buffer;
+   model.sense = gmoSense(gmo);
+   model.minf = gmoMinf(gmo);
+   model.pinf = gmoPinf(gmo);
+
+   model.uellabels.resize(dctNUels(dct) + 1);
+   for( int u = 0; u <= dctNUels(dct); ++u )
+   {
+      buffer[0] = '\0';
+      dctUelLabel(dct, u, buffer, buffer, sizeof(buffer));
+      model.uellabels[u] = buffer;
+   }
+
+   model.blocks.resize(symbols.size());
+
+   model.rowsym.resize(dctNRows(dct));
+   for( int i = 0; i < dctNRows(dct); ++i )
+   {
+      dctRowUels(dct, i, &symIndex, uelIndices, &symDim);
+      Model::Block& b = model.blocks.at(symIndex);
+      if( b.offset < 0 )
+      {
+         b.start = model.rowuels.size();
+         b.offset = i;
+         b.dim = symDim;
+      }
+      assert(b.dim == symDim && b.start + (size_t)(i - b.offset) * b.dim == model.rowuels.size());
+      model.rowuels.insert(model.rowuels.end(), uelIndices, uelIndices + symDim);
+      model.rowsym[i] = symIndex;
+   }
+
+   model.colsym.resize(dctNCols(dct));
+   for( int j = 0; j < dctNCols(dct); ++j )
+   {
+      dctColUels(dct, j, &symIndex, uelIndices, &symDim);
+      Model::Block& b = model.blocks.at(symIndex);
+      if( b.offset < 0 )
+      {
+         b.start = model.coluels.size();
+         b.offset = j;
+         b.dim = symDim;
       }
-      //std::cout << ") type " << symType << " dim " << symDim << " (" << symText << ")" << std::endl;
+      assert(b.dim == symDim && b.start + (size_t)(j - b.offset) * b.dim == model.coluels.size());
+      model.coluels.insert(model.coluels.end(), uelIndices, uelIndices + symDim);
+      model.colsym[j] = symIndex;
+   }
 
-      // check whether symbol is actually used in model
-      // if it was the original objective variable or objective constraint, then it could have been reformulated out, though it is still in dct
-      // thus, should be enough to do this for 0-dim symbols
-      if( symDim == 0 )
+   // only symbols in the model have solver indices
+   model.lb.assign(dctNCols(dct), NOVALUE);
+   model.ub.assign(dctNCols(dct), NOVALUE);
+   model.vartype.assign(dctNCols(dct), -1);
+   model.rhs.assign(dctNRows(dct), NOVALUE);
+   model.equtype.assign(dctNRows(dct), -1);
+   for( auto& e : symbols )
+   {
+      for( int idx = e.offset; idx < e.offset + e.entries; ++idx )
       {
-         int idx = dctSymOffset(dct, i);
-         if( symType == dctvarSymType  )
+         if( e.type == Symbol::Variable )
          {
-            // FIXME this prints a message if the var is the objective var that has been reformulated out, but then returns -2
-            idx = gmoGetjSolver(gmo, idx);
-            if( idx < 0 || idx >= gmoN(gmo) )
-               symbols.back().type = Symbol::None;
+            int j = gmoGetjSolver(gmo, idx);
+            model.lb[idx] = gmoGetVarLowerOne(gmo, j);
+            model.ub[idx] = gmoGetVarUpperOne(gmo, j);
+            model.vartype[idx] = gmoGetVarTypeOne(gmo, j);
          }
-         else if( symType == dcteqnSymType )
+         else if( e.type == Symbol::Constraint )
          {
-            // FIXME this prints a message if the equ is the objective that has been reformulated out, but then returns -2
-            idx = gmoGetiSolver(gmo, idx);
-            if( idx < 0 || idx >= gmoM(gmo) )
-               symbols.back().type = Symbol::None;
+            int i = gmoGetiSolver(gmo, idx);
+            model.rhs[idx] = gmoGetRhsOne(gmo, i);
+            model.equtype[idx] = gmoGetEquTypeOne(gmo, i);
          }
       }
    }
 
-#if 0
-   for( int u = 0; u < dctNUels(dct); ++u )
+   if( !options.solution )
+      return;
+
+   // solution by solver index, taken in bulk, then moved to dct index like bounds and rhs
+   std::vector<double> level(std::max(gmoN(gmo), gmoM(gmo)));
+   std::vector<double> marginal(level.size());
+   std::vector<int> basis(level.size());
+
+   model.varlevel.assign(dctNCols(dct), NOVALUE);
+   model.varmarginal.assign(dctNCols(dct), NOVALUE);
+   model.varbasis.assign(dctNCols(dct), -1);
+   gmoGetVarL(gmo, level.data());
+   gmoGetVarM(gmo, marginal.data());
+   gmoGetVarStat(gmo, basis.data());
+   for( auto& e : symbols )
    {
-      char uelLabel[GMS_SSSIZE];
-      uelLabel[0] = '\0';
-      dctUelLabel(dct, u, uelLabel, uelLabel, sizeof(uelLabel));
-      std::cout << "UEL " << u << " = " << uelLabel << std::endl;
+      if( e.type != Symbol::Variable )
+         continue;
+      for( int idx = e.offset; idx < e.offset + e.entries; ++idx )
+      {
+         int j = gmoGetjSolver(gmo, idx);
+         if( j < 0 )
+            continue;
+         model.varlevel[idx] = level[j];
+         model.varmarginal[idx] = marginal[j];
+         model.varbasis[idx] = basis[j];
+      }
    }
-#endif
 
+   model.equlevel.assign(dctNRows(dct), NOVALUE);
+   model.equmarginal.assign(dctNRows(dct), NOVALUE);
+   model.equbasis.assign(dctNRows(dct), -1);
+   gmoGetEquL(gmo, level.data());
+   gmoGetEquM(gmo, marginal.data());
+   gmoGetEquStat(gmo, basis.data());
+   for( auto& e : symbols )
+   {
+      if( e.type != Symbol::Constraint )
+         continue;
+      for( int idx = e.offset; idx < e.offset + e.entries; ++idx )
+      {
+         int i = gmoGetiSolver(gmo, idx);
+         if( i < 0 )
+            continue;
+         model.equlevel[idx] = level[i];
+         model.equmarginal[idx] = marginal[i];
+         model.equbasis[idx] = basis[i];
+      }
+   }
 }
 
+// collects the Jacobian into coefs, row-wise; symbols of rows and columns are taken from model, see extractModel
 void analyzeMatrix(
-   gmoHandle_t gmo,
-   dctHandle_t dct
+   gmoHandle_t gmo
    )
 {
    double jacval;
    int colidx;
    int nlflag;
 
-   int rowSymIdx;
-   int rowUels[GMS_MAX_INDEX_DIM];
-   int rowSymDim;
-
-   int colSymIdx;
-   int colUels[GMS_MAX_INDEX_DIM];
-   int colSymDim;
-
    for( int rowidx = 0; rowidx < gmoM(gmo); ++rowidx )
    {
-      dctRowUels(dct, gmoGetiModel(gmo, rowidx), &rowSymIdx, rowUels, &rowSymDim);
+      int rowSymIdx = model.rowsym[gmoGetiModel(gmo, rowidx)];
 
       void* jacptr = NULL;
       gmoGetRowJacInfoOne(gmo, rowidx, &jacptr, &jacval, &colidx, &nlflag);
       while( jacptr != NULL )
       {
-         dctColUels(dct, gmoGetjModel(gmo, colidx), &colSymIdx, colUels, &colSymDim);
+         int colSymIdx = model.colsym[gmoGetjModel(gmo, colidx)];
 
          if( coefs.count(std::pair<int,int>(rowSymIdx, colSymIdx)) == 0 )
          {
@@ -284,20 +1649,63 @@ void analyzeMatrix(
          }
 
          Coefficient& c(coefs.at(std::pair<int,int>(rowSymIdx, colSymIdx)));
-         c.entries.push_back(std::tuple<int, int, double>(gmoGetiModel(gmo, rowidx), gmoGetjModel(gmo, colidx), jacval));
+         c.addEntry(gmoGetiModel(gmo, rowidx), gmoGetjModel(gmo, colidx), jacval, true);
 
          gmoGetRowJacInfoOne(gmo, rowidx, &jacptr, &jacval, &colidx, &nlflag);
       }
    }
 }
 
+// as analyzeMatrix, but only records the blocks and counts their entries, going through the Jacobian column-wise
+// the entries are taken from gmo again when printing, see Coefficient::forEachRow
+void analyzeMatrixColumns(
+   gmoHandle_t gmo
+   )
+{
+   double jacval;
+   int rowidx;
+   int nlflag;
+
+   for( auto& var : symbols )
+   {
+      if( var.type != Symbol::Variable )
+         continue;
+
+      // blocks of this variable, by equation symbol index
+      std::map<int, Coefficient*> blocks;
+
+      for( int idx = var.offset; idx < var.offset + var.entries; ++idx )
+      {
+         int j = gmoGetjSolver(gmo, idx);
+         if( j < 0 )
+            continue;
+
+         void* jacptr = NULL;
+         gmoGetColJacInfoOne(gmo, j, &jacptr, &jacval, &rowidx, &nlflag);
+         while( jacptr != NULL )
+         {
+            int i = gmoGetiModel(gmo, rowidx);
+            int rowSymIdx = model.rowsym[i];
+
+            Coefficient*& c = blocks[rowSymIdx];
+            if( c == NULL )
+            {
+               auto key = std::make_pair(rowSymIdx, var.symIdx);
+               c = &coefs.insert(std::make_pair(key, Coefficient(symbols[rowSymIdx], var))).first->second;
+            }
+            c->addEntry(i, idx, jacval, false);
+
+            gmoGetColJacInfoOne(gmo, j, &jacptr, &jacval, &rowidx, &nlflag);
+         }
+      }
+   }
+}
+
 void analyzeObjective(
-   gmoHandle_t gmo,
-   dctHandle_t dct
+   gmoHandle_t gmo
    )
 {
    int symIndex;
-   int uelIdxs[GMS_MAX_INDEX_DIM];
    int dim;
 
    int nz = gmoObjNZ(gmo);
@@ -308,15 +1716,16 @@ void analyzeObjective(
 
    for( int i = 0; i < nz; ++i )
    {
-      dctColUels(dct, colidx[i], &symIndex, uelIdxs, &dim);
+      symIndex = model.colsym[gmoGetjModel(gmo, colidx[i])];
 
       if( coefs.count(std::pair<int,int>(0, symIndex)) == 0 )
       {
          coefs.insert(std::pair<std::pair<int,int>, Coefficient>(std::pair<int,int>(0, symIndex), Coefficient(symbols[0], symbols[symIndex])));
       }
 
+      // the objective is not in the Jacobian, so its entries are kept with options.lowmem, too
       Coefficient& c(coefs.at(std::pair<int,int>(0, symIndex)));
-      c.entries.push_back(std::tuple<int, int, double>(gmoObjRow(gmo), gmoGetjModel(gmo, colidx[i]), jacval[i]));
+      c.addEntry(gmoObjRow(gmo), gmoGetjModel(gmo, colidx[i]), jacval[i], true);
    }
 
    delete[] colidx;
@@ -336,21 +1745,31 @@ void analyzeObjective(
 #endif
 }
 
+// whether a variable or equation has a DATA table: a scalar one only with options.structure,
+// as its bounds or rhs are data then, which the structure must not contain
+static
+bool hasSymbolTable(
+   const Symbol& e
+   )
+{
+   if( e.type != Symbol::Variable && e.type != Symbol::Constraint )
+      return false;
+
+   return e.dim() > 0 || options.structure != NULL;
+}
+
 // declare index for each variable and equation
 void printInputDataModel(
-   rapidjson::PrettyWriter<rapidjson::StringBuffer>& w,
-   dctHandle_t dct
+   MosdexWriter& w
    )
 {
    w.Key("INPUT_DATA_MODEL");
+   outindex.begin(outindex.sections, "INPUT_DATA_MODEL");
    w.StartObject();
 
    for( auto& e : symbols )
    {
-      if( e.type == Symbol::None )
-         continue;
-
-      if( e.dim() == 0 )
+      if( !hasSymbolTable(e) )
          continue;
 
       w.Key(e.name);
@@ -382,6 +1801,10 @@ void printInputDataModel(
    {
       Coefficient& c(cit.second);
 
+      // scalar blocks have no table
+      if( c.scalar )
+         continue;
+
       w.Key(c.getName());
 
       w.StartObject();
@@ -403,183 +1826,546 @@ void printInputDataModel(
 
       w.Key("val");
       w.String("Double");
-
+
+      w.EndObject();
+   }
+
+   w.EndObject();
+   outindex.end(outindex.sections);
+}
+
+// collects the members of the top-level HASHES section of a MOSDEX document, without building the document
+class HashesHandler : public rapidjson::BaseReaderHandler<>
+{
+public:
+   std::map<std::string, std::string>& hashes;
+   int depth = 0;
+   bool inhashes = false;
+   std::string key;
+
+   HashesHandler(std::map<std::string, std::string>& hashes_)
+   : hashes(hashes_)
+   { }
+
+   bool Key(const char* str, rapidjson::SizeType length, bool)
+   {
+      if( depth == 1 )
+         inhashes = std::string(str, length) == "HASHES";
+      else if( depth == 2 && inhashes )
+         key.assign(str, length);
+      return true;
+   }
+
+   bool String(const char* str, rapidjson::SizeType length, bool)
+   {
+      if( depth == 2 && inhashes )
+         hashes[key].assign(str, length);
+      return true;
+   }
+
+   bool StartObject() { ++depth; return true; }
+   bool EndObject(rapidjson::SizeType) { --depth; return true; }
+   bool StartArray() { ++depth; return true; }
+   bool EndArray(rapidjson::SizeType) { --depth; return true; }
+};
+
+// reads the content hashes of the DATA tables of a previous export into basehashes
+static
+bool readBaseHashes(
+   const char* filename
+   )
+{
+   MosdexInputStream is;
+   if( !is.open(filename, compressionFromFilename(filename)) )
+      return false;
+
+   HashesHandler handler(basehashes);
+   rapidjson::Reader reader;
+   if( reader.Parse(is, handler).IsError() || is.failed() )
+   {
+      std::cerr << "Error reading " << filename << std::endl;
+      return false;
+   }
+
+   if( basehashes.empty() )
+   {
+      std::cerr << filename << " has no HASHES, it needs to be written with -hashes" << std::endl;
+      return false;
+   }
+
+   return true;
+}
+
+// records the content hash of a DATA table, if hashes are written
+// if the base export has a table with the same name and hash, prints a reference to it and returns true
+static
+bool printBaseReference(
+   MosdexWriter&      w,
+   const std::string& name,
+   const std::string& hash
+   )
+{
+   tablehashes[name] = hash;
+
+   auto it = basehashes.find(name);
+   if( it == basehashes.end() || it->second != hash )
+      return false;
+
+   w.StartObject();
+   w.Key("LAYOUT");
+   w.String("BASE");
+   w.EndObject();
+
+   return true;
+}
+
+// DATA table of a variable or equation: index entries, and bounds or rhs
+static
+DataTable getSymbolTable(
+   const Symbol& e
+   )
+{
+   double vals[2];
+
+   DataTable table;
+   table.name = e.name;
+   for( int d = 0; d < e.dim(); ++d )
+      table.keys.push_back(e.getDomName(d));
+   if( e.type == Symbol::Variable )
+   {
+      table.values.push_back("lb");
+      table.values.push_back("ub");
+   }
+   else if( e.type == Symbol::Constraint )
+   {
+      table.values.push_back("rhs");
+   }
+
+   for( int k = 0; k < e.entries; ++k )
+   {
+      int idx = e.index(k);
+      const int* uelIndices;
+
+      if( e.type == Symbol::Variable )
+      {
+         uelIndices = model.colUels(idx);
+
+         double lb = model.lb[idx];
+         double ub = model.ub[idx];
+
+         vals[0] = NOVALUE;
+         vals[1] = NOVALUE;
+         if( model.vartype[idx] == gmovar_B )
+         {
+            if( lb != 0.0 )
+               vals[0] = lb;
+            if( ub != 1.0 )
+               vals[1] = ub;
+         }
+         else
+         {
+            if( lb != model.minf )
+               vals[0] = lb;
+            if( ub != model.pinf )
+               vals[1] = ub;
+         }
+      }
+      else
+      {
+         uelIndices = model.rowUels(idx);
+         vals[0] = model.rhs[idx];
+      }
+
+      table.addRow(uelIndices, vals);
+   }
+
+   return table;
+}
+
+// a DATA table ready to be printed: its rows, its content hash if options.hashes,
+// and for a coefficient table printed as pattern with options.hashes the table whose rows it refers to
+class PreparedTable
+{
+public:
+   DataTable table;
+   DataTable pattern;
+   std::string hash;
+};
+
+// makes items 0, ..., n-1 for a consumer that takes them in order
+// with options.pipeline, a separate thread makes them, running ahead of the consumer by at most maxahead items,
+// otherwise an item is made when it is asked for
+template<typename T>
+class Pipeline
+{
+public:
+   Pipeline(
+      size_t                   n_,
+      std::function<T(size_t)> make_
+      )
+   : n(n_), make(make_)
+   {
+      if( options.pipeline )
+         producer = std::thread(&Pipeline::run, this);
+   }
+
+   ~Pipeline()
+   {
+      if( producer.joinable() )
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+         }
+         cond.notify_all();
+         producer.join();
+      }
+   }
+
+   T next()
+   {
+      if( !options.pipeline )
+         return make(taken++);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [this] { return !queue.empty(); });
+      T item = std::move(queue.front());
+      queue.pop_front();
+      cond.notify_all();
+
+      return item;
+   }
+
+private:
+   void run()
+   {
+      for( size_t i = 0; i < n; ++i )
+      {
+         T item = make(i);
+
+         std::unique_lock<std::mutex> lock(mutex);
+         cond.wait(lock, [this] { return queue.size() < maxahead || stop; });
+         if( stop )
+            return;
+         queue.push_back(std::move(item));
+         cond.notify_all();
+      }
+   }
+
+   static const size_t maxahead = 4;
+
+   size_t n;
+   std::function<T(size_t)> make;
+   size_t taken = 0;
+
+   std::thread producer;
+   std::mutex mutex;
+   std::condition_variable cond;
+   std::deque<T> queue;
+   bool stop = false;
+};
+
+// readers built on rapidjson cannot hold arrays of more than 2^32-1 elements,
+// so larger tables have to go into a binary DATA file or into JSON-Lines files
+static
+void checkRowCount(
+   const std::string& name,
+   size_t             nrows
+   )
+{
+   if( options.binary || options.shards || nrows <= std::numeric_limits<rapidjson::SizeType>::max() )
+      return;
+
+   std::cerr << "DATA table " << name << " has " << nrows << " rows, more than a JSON array can hold; use -binary or -shards" << std::endl;
+   writeerror = true;
+}
+
+// print symbol index entries, rhs, bounds, for each variable and equation
+static
+void printSymbolData(
+   MosdexWriter& w
+   )
+{
+   std::vector<const Symbol*> tabled;
+   for( auto& e : symbols )
+      if( hasSymbolTable(e) )
+         tabled.push_back(&e);
+
+   // tables are built and hashed while earlier ones are printed, with options.pipeline
+   Pipeline<PreparedTable> tables(tabled.size(), [&tabled](size_t i)
+      {
+         PreparedTable p;
+         p.table = getSymbolTable(*tabled[i]);
+         if( options.hashes )
+            p.hash = p.table.hashContent(DataTable::layoutName());
+         return p;
+      });
+
+   for( const Symbol* e : tabled )
+   {
+      PreparedTable p = tables.next();
+      checkRowCount(p.table.name, p.table.nrows);
+
+      w.Key(e->name);
+      outindex.begin(outindex.tables, e->name);
+      if( !options.hashes || !printBaseReference(w, e->name, p.hash) )
+         p.table.print(w);
+      outindex.end(outindex.tables);
+   }
+}
+
+// binary and sharded tables are written row by row, so dense and pattern layouts are only used for JSON tables
+static
+bool printedDense(
+   const Coefficient& c
+   )
+{
+   return c.structure == Coefficient::Dense && !options.binary && !options.shards;
+}
+
+static
+bool printedPattern(
+   const Coefficient& c
+   )
+{
+   return !printedDense(c) && c.pattern != NULL && !options.binary && !options.shards;
+}
+
+void printCoefficientData(
+   MosdexWriter& w
+   )
+{
+   std::vector<const Coefficient*> tabled;
+   for( auto& cit : coefs )
+      if( !cit.second.scalar )
+         tabled.push_back(&cit.second);
+
+   // streamed from gmo on this thread, as gmo is not thread-safe
+   if( options.lowmem )
+   {
+      for( const Coefficient* c : tabled )
+      {
+         checkRowCount(c->getName(), c->nentries);
+
+         w.Key(c->getName());
+         outindex.begin(outindex.tables, c->getName());
+         c->printStreamed(w);
+         outindex.end(outindex.tables);
+      }
+      return;
+   }
+
+   Pipeline<PreparedTable> tables(tabled.size(), [&tabled](size_t i)
+      {
+         const Coefficient& c(*tabled[i]);
+
+         PreparedTable p;
+         p.table = c.getTable();
+         if( printedPattern(c) && options.hashes )
+            p.pattern = c.pattern->getTable();
+
+         if( options.hashes )
+         {
+            // a table printed as pattern can only be taken from the base if the table it refers to is the same, too
+            std::string layout = DataTable::layoutName();
+            if( printedDense(c) )
+               layout = "DENSE";
+            else if( printedPattern(c) )
+               layout = "PATTERN " + c.pattern->getName() + " " + p.pattern.hashContent("");
+            p.hash = p.table.hashContent(layout);
+         }
+
+         return p;
+      });
+
+   for( const Coefficient* c : tabled )
+   {
+      PreparedTable p = tables.next();
+      checkRowCount(p.table.name, p.table.nrows);
+
+      w.Key(c->getName());
+      outindex.begin(outindex.tables, c->getName());
+      if( !options.hashes || !printBaseReference(w, c->getName(), p.hash) )
+      {
+         if( printedDense(*c) )
+            p.table.printDense(w);
+         else if( printedPattern(*c) )
+            p.table.printPattern(w, c->pattern->getName(), c->sortedrows, c->pattern->sortedrows);
+         else
+            p.table.print(w);
+      }
+      outindex.end(outindex.tables);
+   }
+}
+
+// columns of the OUTPUT_DATA tables, after the key columns
+static const char* const solutioncolumns[] = { "level", "marginal", "basis" };
+
+// declares an OUTPUT_DATA table for each variable and equation, with the same key columns as its DATA table
+void printOutputDataModel(
+   MosdexWriter& w
+   )
+{
+   w.Key("OUTPUT_DATA_MODEL");
+   outindex.begin(outindex.sections, "OUTPUT_DATA_MODEL");
+   w.StartObject();
+
+   for( auto& e : symbols )
+   {
+      if( e.type != Symbol::Variable && e.type != Symbol::Constraint )
+         continue;
+
+      w.Key(e.name);
+
+      w.StartObject();
+      for( int d = 0; d < e.dim(); ++d )
+      {
+         w.Key(std::string("*") + e.getDomName(d));
+         w.String("String");
+      }
+      w.Key(solutioncolumns[0]);
+      w.String("Double");
+      w.Key(solutioncolumns[1]);
+      w.String("Double");
+      w.Key(solutioncolumns[2]);
+      w.String("String");
       w.EndObject();
    }
 
    w.EndObject();
+   outindex.end(outindex.sections);
 }
 
-// print symbol index entries, rhs, bounds, for each variable and equation
+// prints the solution of a variable or equation as { "ROWS": n, "COLUMNS": { col: [ ... ], ... } },
+// straight from the model, without collecting the rows into a DataTable first
+// with options.dictionary, UEL columns are encoded as in DataTable::printColumns and "DICTIONARY": [ ... ] follows
 static
-void printSymbolData(
-   rapidjson::PrettyWriter<rapidjson::StringBuffer>& w,
-   gmoHandle_t gmo,
-   dctHandle_t dct
+void printSolutionTable(
+   MosdexWriter& w,
+   const Symbol& e
    )
 {
-   int uelIndices[GMS_MAX_INDEX_DIM];
-   char uelLabel[GMS_SSSIZE];
+   static const char* const basisname[] = { "LOWER", "UPPER", "BASIC", "SUPERBASIC" };
 
-   for( auto& e : symbols )
+   bool isvar = e.type == Symbol::Variable;
+   const std::vector<double>& level = isvar ? model.varlevel : model.equlevel;
+   const std::vector<double>& marginal = isvar ? model.varmarginal : model.equmarginal;
+   const std::vector<int>& basis = isvar ? model.varbasis : model.equbasis;
+
+   auto uelsOf = [&](int k) { return isvar ? model.colUels(e.index(k)) : model.rowUels(e.index(k)); };
+
+   // dictionary code of each UEL, in order of first appearance
+   std::unordered_map<int, int> uelcode;
+   std::vector<int> dict;
+   if( options.dictionary )
    {
-      if( e.dim() == 0 )
-         continue;
+      for( int k = 0; k < e.entries; ++k )
+         for( int d = 0; d < e.dim(); ++d )
+            if( uelcode.emplace(uelsOf(k)[d], (int)dict.size()).second )
+               dict.push_back(uelsOf(k)[d]);
+   }
 
-      if( e.type == Symbol::None )
-         continue;
+   w.StartObject();
 
-      w.Key(e.name);
+   w.Key("ROWS");
+   w.Uint64((uint64_t)e.entries);
 
+   w.Key("COLUMNS");
+   w.StartObject();
+   for( int d = 0; d < e.dim(); ++d )
+   {
+      w.Key(e.getDomName(d));
       w.StartArray();
-
-      for( int idx = dctSymOffset(dct, e.symIdx); ; ++idx )
+      for( int k = 0; k < e.entries; ++k )
       {
-         int symIndex;
-         int symDim;
-         assert(idx >= 0);
-
-         if( e.type == Symbol::Variable )
-         {
-            if( idx >= dctNCols(dct) )
-               break;
-            dctColUels(dct, idx, &symIndex, uelIndices, &symDim);
-         }
+         if( options.dictionary )
+            w.Int(uelcode[uelsOf(k)[d]]);
          else
-         {
-            if( idx >= dctNRows(dct) )
-               break;
-            dctRowUels(dct, idx, &symIndex, uelIndices, &symDim);
-         }
-         if(symIndex != e.symIdx)
-            break;
-
-         assert(symDim == e.dim());
-
-         w.StartObject();
-         for( int d = 0; d < e.dim(); ++d )
-         {
-            uelLabel[0] = '\0';
-            dctUelLabel(dct, uelIndices[d], uelLabel, uelLabel, sizeof(uelLabel));
-
-            w.Key(e.getDomName(d));
-            w.String(uelLabel);
-         }
-
-         if( e.type == Symbol::Variable )
-         {
-            double lb = gmoGetVarLowerOne(gmo, gmoGetjSolver(gmo, idx));
-            double ub = gmoGetVarUpperOne(gmo, gmoGetjSolver(gmo, idx));
-
-            if( gmoGetVarTypeOne(gmo, gmoGetjSolver(gmo, idx)) == gmovar_B )
-            {
-               if( lb != 0.0 )
-               {
-                  w.Key("lb");
-                  w.Double(lb);
-               }
-               if( ub != 1.0 )
-               {
-                  w.Key("ub");
-                  w.Double(ub);
-               }
-            }
-            else
-            {
-               if( lb != gmoMinf(gmo) )
-               {
-                  w.Key("lb");
-                  w.Double(lb);
-               }
-               if( ub != gmoPinf(gmo) )
-               {
-                  w.Key("ub");
-                  w.Double(ub);
-               }
-            }
-         }
-         else if( e.type == Symbol::Constraint )
-         {
-            w.Key("rhs");
-            w.Double(gmoGetRhsOne(gmo, gmoGetiSolver(gmo, idx)));
-         }
-
-         w.EndObject();
+            w.String(model.uelLabel(uelsOf(k)[d]));
       }
-
       w.EndArray();
    }
-}
-
-void printCoefficientData(
-   rapidjson::PrettyWriter<rapidjson::StringBuffer>& w,
-   dctHandle_t dct
-   )
-{
-   int rowUels[GMS_MAX_INDEX_DIM];
-   int colUels[GMS_MAX_INDEX_DIM];
 
-   char uelLabel[GMS_SSSIZE];
-
-   for( auto& cit : coefs )
+   for( int v = 0; v < 2; ++v )
    {
-      Coefficient& c(cit.second);
-
-      w.Key(c.getName());
+      const std::vector<double>& vals = v == 0 ? level : marginal;
+      w.Key(solutioncolumns[v]);
       w.StartArray();
-
-      for( auto& e : c.entries )
+      for( int k = 0; k < e.entries; ++k )
       {
-         int symidx;
-         int dim;
-         dctRowUels(dct, std::get<0>(e), &symidx, rowUels, &dim);
-         dctColUels(dct, std::get<1>(e), &symidx, colUels, &dim);
-
-         w.StartObject();
-         for( int d = 0; d < c.equation.dim(); ++d )
-         {
-            uelLabel[0] = '\0';
-            dctUelLabel(dct, rowUels[d], uelLabel, uelLabel, sizeof(uelLabel));
+         int idx = e.index(k);
+         if( std::isnan(vals[idx]) )
+            w.Null();
+         else
+            w.Double(vals[idx]);
+      }
+      w.EndArray();
+   }
 
-            w.Key(c.equation.getDomName(d));
-            w.String(uelLabel);
-         }
+   w.Key(solutioncolumns[2]);
+   w.StartArray();
+   for( int k = 0; k < e.entries; ++k )
+   {
+      int idx = e.index(k);
+      if( basis[idx] >= gmoBstat_Lower && basis[idx] <= gmoBstat_Super )
+         w.String(basisname[basis[idx]]);
+      else
+         w.Null();
+   }
+   w.EndArray();
+   w.EndObject();
 
-         for( int d = 0; d < c.variable.dim(); ++d )
-         {
-            uelLabel[0] = '\0';
-            dctUelLabel(dct, colUels[d], uelLabel, uelLabel, sizeof(uelLabel));
+   if( options.dictionary )
+   {
+      w.Key("DICTIONARY");
+      w.StartArray();
+      for( int u : dict )
+         w.String(model.uelLabel(u));
+      w.EndArray();
+   }
 
-            if( c.varDomEqualsEquDom[d] < 0 )
-            {
-               w.Key(c.variable.getDomName(d));
-               w.String(uelLabel);
-            }
-         }
+   w.EndObject();
+}
 
-         w.Key("val");
-         w.Double(std::get<2>(e));
+// prints the OUTPUT_DATA tables, column-wise whatever the layout of DATA
+void printOutputData(
+   MosdexWriter& w
+   )
+{
+   w.Key("OUTPUT_DATA");
+   outindex.begin(outindex.sections, "OUTPUT_DATA");
 
-         w.EndObject();
-      }
+   w.SetFormatOptions(rapidjson::kFormatSingleLineArray);
+   w.StartObject();
+   for( auto& e : symbols )
+   {
+      if( e.type != Symbol::Variable && e.type != Symbol::Constraint )
+         continue;
 
-      w.EndArray();
+      w.Key(e.name);
+      printSolutionTable(w, e);
    }
+   w.EndObject();
+   w.SetFormatOptions(options.columnar ? rapidjson::kFormatSingleLineArray : rapidjson::kFormatDefault);
+
+   outindex.end(outindex.sections);
 }
 
 void printSymbols(
-   rapidjson::PrettyWriter<rapidjson::StringBuffer>& w,
-   gmoHandle_t gmo,
-   dctHandle_t dct,
+   MosdexWriter& w,
    int type
    )
 {
+   const char* section;
    if( type == Symbol::Variable )
-      w.Key("VARIABLES");
+      section = "VARIABLES";
    else if( type == Symbol::Constraint )
-      w.Key("CONSTRAINTS");
+      section = "CONSTRAINTS";
    else
-      w.Key("DECISION_EXPRESSIONS");
+      section = "DECISION_EXPRESSIONS";
+
+   w.Key(section);
+   outindex.begin(outindex.sections, section);
 
    w.StartArray();
    for( auto& e : symbols )
@@ -605,11 +2391,10 @@ void printSymbols(
       if( e.type == Symbol::Variable )
       {
          // get a col for this symbol: for bounds if dim=0 and for vartype
-         int colidx = dctSymOffset(dct, e.symIdx);
-         colidx = gmoGetjSolver(gmo, colidx);
-         assert(colidx >= 0 && colidx < gmoN(gmo));
+         int colidx = e.offset;
+         assert(e.entries > 0);
 
-         switch( gmoGetVarTypeOne(gmo, colidx) )
+         switch( model.vartype[colidx] )
          {
             case gmovar_B:
                w.Key("TYPE");
@@ -632,7 +2417,7 @@ void printSymbols(
 
          w.Key("BOUNDS");
          w.StartObject();
-         if( e.dim() > 0 )
+         if( hasSymbolTable(e) )
          {
             w.Key("LOWER");
             w.String(e.name + ".lb");
@@ -641,30 +2426,30 @@ void printSymbols(
          }
          else
          {
-            if( gmoGetVarTypeOne(gmo, colidx) == gmovar_B )
+            if( model.vartype[colidx] == gmovar_B )
             {
-               if( gmoGetVarLowerOne(gmo, colidx) != 0.0 )
+               if( model.lb[colidx] != 0.0 )
                {
                   w.Key("LOWER");
-                  w.Double(gmoGetVarLowerOne(gmo, colidx));
+                  w.Double(model.lb[colidx]);
                }
-               if( gmoGetVarUpperOne(gmo, colidx) != 1.0 )
+               if( model.ub[colidx] != 1.0 )
                {
                   w.Key("UPPER");
-                  w.Double(gmoGetVarUpperOne(gmo, colidx));
+                  w.Double(model.ub[colidx]);
                }
             }
             else
             {
-               if( gmoGetVarLowerOne(gmo, colidx) != gmoMinf(gmo) )
+               if( model.lb[colidx] != model.minf )
                {
                   w.Key("LOWER");
-                  w.Double(gmoGetVarLowerOne(gmo, colidx));
+                  w.Double(model.lb[colidx]);
                }
-               if( gmoGetVarUpperOne(gmo, colidx) != gmoPinf(gmo) )
+               if( model.ub[colidx] != model.pinf )
                {
                   w.Key("UPPER");
-                  w.Double(gmoGetVarUpperOne(gmo, colidx));
+                  w.Double(model.ub[colidx]);
                }
             }
          }
@@ -673,18 +2458,17 @@ void printSymbols(
       else if( e.type == Symbol::Constraint )
       {
          // get a row for this symbol: for rhs if dim=0 and for rowsense
-         int rowidx = dctSymOffset(dct, e.symIdx);
-         rowidx = gmoGetiSolver(gmo, rowidx);
-         assert(rowidx >= 0 && rowidx < gmoM(gmo));
+         int rowidx = e.offset;
+         assert(e.entries > 0);
 
          w.Key("RHS");
-         if( e.dim() > 0 )
+         if( hasSymbolTable(e) )
             w.String(e.name + ".rhs");
          else
-            w.Double(gmoGetRhsOne(gmo, rowidx));
+            w.Double(model.rhs[rowidx]);
 
          w.Key("SENSE");
-         switch( gmoGetEquTypeOne(gmo, rowidx) )
+         switch( model.equtype[rowidx] )
          {
             case gmoequ_E :
             case gmoequ_B :
@@ -708,7 +2492,7 @@ void printSymbols(
       else if( e.type == Symbol::Objective )
       {
          w.Key("SENSE");
-         if( gmoSense(gmo) == gmoObj_Min )
+         if( model.sense == gmoObj_Min )
             w.String("minimize");
          else
             w.String("maximize");
@@ -720,14 +2504,15 @@ void printSymbols(
       w.EndObject();
    }
    w.EndArray();
+   outindex.end(outindex.sections);
 }
 
 void printCoefficients(
-   rapidjson::PrettyWriter<rapidjson::StringBuffer>& w,
-   dctHandle_t dct
+   MosdexWriter& w
    )
 {
    w.Key("COEFFICIENTS");
+   outindex.begin(outindex.sections, "COEFFICIENTS");
 
    w.StartArray();
    for( auto& cit : coefs )
@@ -743,7 +2528,10 @@ void printCoefficients(
       w.String(c.variable.name);
 
       w.Key("ENTRIES");
-      w.String(c.getName() + ".val");
+      if( c.scalar )
+         w.Double(c.firstvalue);
+      else
+         w.String(c.getName() + ".val");
 
       std::string cond;
       for( int d = 0; d < c.variable.dim(); ++d )
@@ -753,15 +2541,103 @@ void printCoefficients(
             if( cond != "" )
                cond += " and ";
             cond += c.variable.name + "." + c.variable.getDomName(d) + " == ";
-            cond += c.equation.name + "." + c.equation.getDomName(d);
+            cond += c.equation.name + "." + c.equation.getDomName(c.varDomEqualsEquDom[d]);
          }
       }
       w.Key("CONDITION");
       w.String(cond);
 
+      w.Key("STRUCTURE");
+      switch( c.structure )
+      {
+         case Coefficient::Subset:
+            w.String("SUBSET");
+            break;
+         case Coefficient::EqualityConditioned:
+            w.String("EQUALITY_CONDITIONED");
+            break;
+         case Coefficient::Dense:
+            // whether all key tuples are present depends on the data, not on the structure
+            w.String(options.structure != NULL ? "SUBSET" : "DENSE");
+            break;
+      }
+
       w.EndObject();
    }
    w.EndArray();
+   outindex.end(outindex.sections);
+}
+
+// writes the sections that do not depend on the data into options.structure,
+// or checks that the file has the same content if it exists already
+// fingerprint is set to the content hash of the structure, by which the output refers to it
+static
+bool writeStructure(
+   std::string& fingerprint
+   )
+{
+   char pid[32];
+   snprintf(pid, sizeof(pid), ".tmp.%ld", (long)getpid());
+   std::string tmpfile = std::string(options.structure) + pid;
+
+   MosdexOutputStream os;
+   if( !os.open(tmpfile.c_str(), compressionFromFilename(options.structure)) )
+      return false;
+
+   // not part of the output, so not in its index
+   const MosdexOutputStream* indexos = outindex.os;
+   outindex.os = NULL;
+
+   MosdexWriter writer(os);
+   writer.StartObject();
+   printInputDataModel(writer);
+   if( options.solution )
+      printOutputDataModel(writer);
+   printSymbols(writer, Symbol::Variable);
+   printSymbols(writer, Symbol::Constraint);
+   printSymbols(writer, Symbol::Objective);
+   printCoefficients(writer);
+   writer.EndObject();
+   os.Put('\n');
+
+   outindex.os = indexos;
+
+   std::string content;
+   // hashed as written, uncompressed, as the reader hashes it
+   if( !os.close() || !readContent(tmpfile.c_str(), compressionFromFilename(options.structure), content) )
+   {
+      remove(tmpfile.c_str());
+      return false;
+   }
+
+   ContentHash h;
+   h.add(content.data(), content.size());
+   fingerprint = h.hex();
+
+   struct stat st;
+   if( stat(options.structure, &st) != 0 )
+   {
+      if( rename(tmpfile.c_str(), options.structure) != 0 )
+      {
+         std::cerr << "Could not write " << options.structure << std::endl;
+         remove(tmpfile.c_str());
+         return false;
+      }
+      return true;
+   }
+
+   remove(tmpfile.c_str());
+
+   std::string existing;
+   if( !readContent(options.structure, compressionFromFilename(options.structure), existing) )
+      return false;
+   if( existing != content )
+   {
+      std::cerr << "Structure of the model differs from " << options.structure << std::endl;
+      return false;
+   }
+
+   return true;
 }
 
 
@@ -770,7 +2646,6 @@ int main(
    char** argv
 )
 {
-   char buffer[GMS_SSSIZE];
    gmoHandle_t gmo;
    gevHandle_t gev;
    dctHandle_t dct;
@@ -812,7 +2687,190 @@ int main(
    }
 #endif
 
-   if( loadGMS(&gmo, &gev, argv[1]) != RETURN_OK )
+   int argi = 1;
+   for( ; argi < argc && argv[argi][0] == '-'; ++argi )
+   {
+      if( strcmp(argv[argi], "-columnar") == 0 )
+         options.columnar = true;
+      else if( strcmp(argv[argi], "-dictionary") == 0 )
+         options.columnar = options.dictionary = true;
+      else if( strcmp(argv[argi], "-binary") == 0 )
+         options.binary = true;
+      else if( strcmp(argv[argi], "-index") == 0 )
+         options.index = true;
+      else if( strcmp(argv[argi], "-shards") == 0 )
+         options.shards = true;
+      else if( strcmp(argv[argi], "-chunk") == 0 && argi + 1 < argc )
+      {
+         options.shards = true;
+         options.chunk = strtoull(argv[++argi], NULL, 10);
+      }
+      else if( strcmp(argv[argi], "-hashes") == 0 )
+         options.hashes = true;
+      else if( strcmp(argv[argi], "-base") == 0 && argi + 1 < argc )
+      {
+         options.hashes = true;
+         options.base = argv[++argi];
+      }
+      else if( strcmp(argv[argi], "-cache") == 0 && argi + 1 < argc )
+         options.cache = argv[++argi];
+      else if( strcmp(argv[argi], "-cachesize") == 0 && argi + 1 < argc )
+         options.cachesize = strtoull(argv[++argi], NULL, 10) << 20;
+      else if( strcmp(argv[argi], "-stats") == 0 )
+         options.stats = true;
+      else if( strcmp(argv[argi], "-pipeline") == 0 )
+         options.pipeline = true;
+      else if( strcmp(argv[argi], "-solution") == 0 )
+         options.solution = true;
+      else if( strcmp(argv[argi], "-lowmem") == 0 )
+         options.lowmem = true;
+      else if( strcmp(argv[argi], "-structure") == 0 && argi + 1 < argc )
+         options.structure = argv[++argi];
+      else if( strcmp(argv[argi], "-sorted") == 0 )
+         options.sorted = true;
+      else if( strcmp(argv[argi], "-o") == 0 && argi + 1 < argc )
+         options.outfile = argv[++argi];
+      else if( strcmp(argv[argi], "-z") == 0 && argi + 1 < argc )
+      {
+         if( !compressionFromName(argv[++argi], &options.compression) )
+         {
+            std::cerr << "Unknown compression " << argv[argi] << std::endl;
+            return EXIT_FAILURE;
+         }
+         options.compressionset = true;
+      }
+      else
+         break;
+   }
+   if( !options.compressionset )
+      options.compression = compressionFromFilename(options.outfile);
+
+   if( options.binary && options.outfile == NULL )
+   {
+      std::cerr << "-binary requires -o" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   if( options.shards && (options.outfile == NULL || options.binary) )
+   {
+      std::cerr << "-shards requires -o and cannot be combined with -binary" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   // tables in a binary DATA file are referred to by position, so they cannot be taken from another export
+   if( options.base != NULL && options.binary )
+   {
+      std::cerr << "-base cannot be combined with -binary" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   // companion files are referred to by name, so only the output and its index can be cached
+   if( options.cache != NULL && (options.outfile == NULL || options.binary || options.shards) )
+   {
+      std::cerr << "-cache requires -o and cannot be combined with -binary or -shards" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   // coefficient tables are streamed in row or columnar layout only and not held in memory to be hashed or sorted
+   if( options.lowmem && (options.binary || options.shards || options.hashes || options.sorted) )
+   {
+      std::cerr << "-lowmem cannot be combined with -binary, -shards, -hashes, -base, or -sorted" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   // the structure file is written besides the output, and is checked against on each export
+   if( options.structure != NULL && options.cache != NULL )
+   {
+      std::cerr << "-structure cannot be combined with -cache" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   // OUTPUT_DATA is printed column-wise into the output, with labels or dictionary codes, but not into companion files
+   if( options.solution && (options.binary || options.shards) )
+   {
+      std::cerr << "-solution cannot be combined with -binary or -shards" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   // offsets into compressed output would not allow random access
+   if( options.index && (options.outfile == NULL || options.compression != COMPRESSION_NONE) )
+   {
+      std::cerr << "-index requires -o with uncompressed output" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   if( argi != argc - 1 )
+   {
+      std::cerr << "Usage: " << argv[0] << " [options] <file.gms>" << std::endl;
+      std::cerr << "Options:" << std::endl;
+      std::cerr << "  -columnar    print DATA tables as one array per column" << std::endl;
+      std::cerr << "  -dictionary  as -columnar, with UEL columns encoded by a per-table dictionary" << std::endl;
+      std::cerr << "  -binary      write DATA tables into binary file <outfile>.bin" << std::endl;
+      std::cerr << "  -index       write byte offsets of sections and DATA tables into <outfile>.idx" << std::endl;
+      std::cerr << "  -shards      write each DATA table into JSON-Lines file <outfile>.<table>.0.jsonl" << std::endl;
+      std::cerr << "  -chunk <n>   as -shards, with at most n rows per file <outfile>.<table>.<k>.jsonl" << std::endl;
+      std::cerr << "  -hashes      write a content hash for each DATA table into HASHES" << std::endl;
+      std::cerr << "  -base <file> as -hashes, write DATA tables with the same hash as in the export <file> as references to it;" << std::endl;
+      std::cerr << "               <file> is recorded relative to the directory of the output" << std::endl;
+      std::cerr << "  -cache <dir> take output from or add it to a cache of conversions, keyed by model files and options" << std::endl;
+      std::cerr << "  -cachesize <n> evict least recently used conversions if cache is larger than n MB (default: 1024)" << std::endl;
+      std::cerr << "  -stats       report time and peak memory after each phase" << std::endl;
+      std::cerr << "  -pipeline    build DATA tables and write output on separate threads" << std::endl;
+      std::cerr << "  -solution    write levels, marginals, and basis status into OUTPUT_DATA, column-wise, with UELs encoded" << std::endl;
+      std::cerr << "               as for DATA if -dictionary; cannot be combined with -binary or -shards" << std::endl;
+      std::cerr << "  -lowmem      write coefficient tables straight from the GAMS model, without collecting them first" << std::endl;
+      std::cerr << "  -structure <file> write the sections that do not depend on the data into <file>, or check that it has" << std::endl;
+      std::cerr << "               the same content, and write only DATA into the output, which refers to <file>" << std::endl;
+      std::cerr << "  -sorted      write rows of DATA tables ordered by their UELs, whatever order GAMS generated them in" << std::endl;
+      std::cerr << "  -o <file>    write to file instead of stdout" << std::endl;
+      std::cerr << "  -z <comp>    compress output with none, gzip, or zstd (default: by extension .gz, .zst)" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   if( options.base != NULL && !readBaseHashes(options.base) )
+      return EXIT_FAILURE;
+
+   // a previous conversion of the same model with the same options is copied from the cache, without running GAMS
+   MosdexCache cache;
+   bool cacheable = false;
+   std::vector<std::string> cachesuffixes(1, "");
+   if( options.index )
+      cachesuffixes.push_back(".idx");
+   if( options.cache != NULL )
+   {
+      if( !cache.open(options.cache, options.cachesize) )
+         return EXIT_FAILURE;
+
+      // everything that changes the output: GAMS system, layout options, and the base export, see below
+      std::string key = std::string("gams2mosdex 1 " GAMSDIR);
+      key += options.columnar ? " columnar" : "";
+      key += options.dictionary ? " dictionary" : "";
+      key += options.index ? " index" : "";
+      key += options.hashes ? " hashes" : "";
+      key += options.solution ? " solution" : "";
+      key += options.lowmem ? " lowmem" : "";
+      key += options.sorted ? " sorted" : "";
+      key += " compression " + std::to_string((int)options.compression);
+      std::vector<std::string> otherfiles;
+      if( options.base != NULL )
+      {
+         key += std::string(" base ") + options.base;
+         otherfiles.push_back(options.base);
+      }
+
+      // the GAMS system by content, so that an upgrade in place does not serve conversions of the old version:
+      // its release stamp, if there, and the executable that loadGMS runs
+      struct stat st;
+      if( stat(GAMSDIR "/gamsstmp.txt", &st) == 0 )
+         otherfiles.push_back(GAMSDIR "/gamsstmp.txt");
+      otherfiles.push_back(GAMSDIR "/gams");
+
+      cacheable = cache.setKey(key, argv[argi], otherfiles);
+      if( cacheable && cache.fetch(options.outfile, cachesuffixes) )
+         return EXIT_SUCCESS;
+   }
+
+   if( loadGMS(&gmo, &gev, argv[argi]) != RETURN_OK )
       return EXIT_FAILURE;
 
    if( gmoModelType(gmo) != gmoProc_lp && gmoModelType(gmo) != gmoProc_mip && gmoModelType(gmo) != gmoProc_rmip )
@@ -834,47 +2892,187 @@ int main(
    }
 
    analyzeDict(gmo, dct);
-   analyzeMatrix(gmo, dct);
-   analyzeObjective(gmo, dct);
+   extractModel(gmo, dct);
+
+   // model has a copy of everything needed from the dictionary, which is released before the nonzeros are
+   // collected, so that the peak of the load phase does not hold both; gmo forgets it first, so as not to free it again
+   gmoDictSet(gmo, NULL);
+   dctFree(&dct);
+   reportStats("extract");
+
+   if( options.lowmem )
+      analyzeMatrixColumns(gmo);
+   else
+      analyzeMatrix(gmo);
+   analyzeObjective(gmo);
+   reportStats("load");
+
+   // everything else works on model and coefs, so gmo and dct do not need to stay in memory while writing,
+   // unless the coefficients are taken from gmo then
+   if( options.lowmem )
+   {
+      jacgmo = gmo;
+   }
+   else
+   {
+      freeGMS(&gmo, &gev);
+      reportStats("free");
+   }
+
+   for( auto& c : coefs )
+      c.second.analyzeDomains();
+   if( options.sorted )
+   {
+      sortModel();
+      reportStats("sort");
+   }
    for( auto& c : coefs )
-      c.second.analyzeDomains(dct);
+   {
+      c.second.analyzeValues();
+      c.second.analyzeStructure();
+   }
+   if( !options.lowmem )
+      analyzePatterns();
+   reportStats("analyze");
+
+   {
 
+   MosdexOutputStream os;
+   if( !os.open(options.outfile, options.compression) )
+      goto TERMINATE;
+   if( options.pipeline )
+      os.startBackgroundWriter();
+
+   std::string binfile;
+   if( options.binary )
    {
+      binfile = std::string(options.outfile) + ".bin";
+      if( !binarydata.open(binfile.c_str()) )
+         goto TERMINATE;
+   }
+
+   if( options.index )
+      outindex.os = &os;
 
-   rapidjson::StringBuffer s;
-   rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(s);
+   std::string fingerprint;
+   if( options.structure != NULL && !writeStructure(fingerprint) )
+      goto TERMINATE;
+
+   MosdexWriter writer(os);
+   if( options.columnar )
+      writer.SetFormatOptions(rapidjson::kFormatSingleLineArray);
    writer.StartObject();
 
    writer.Key("PROBLEM");
+   outindex.begin(outindex.sections, "PROBLEM");
    writer.StartObject();
    writer.Key("NAME");
-   gmoNameModel(gmo, buffer);
-   writer.String(buffer);
+   writer.String(model.name);
+   // readers need to know how DATA tables are laid out; rows of objects if not given
+   if( options.binary )
+   {
+      // relative to the directory of the output file
+      writer.Key("DATA_LAYOUT");
+      writer.String("BINARY");
+      writer.Key("DATA_FILE");
+      writer.String(binfile.substr(binfile.find_last_of('/') + 1));
+   }
+   else if( options.shards )
+   {
+      writer.Key("DATA_LAYOUT");
+      writer.String("SHARDED");
+   }
+   else if( options.columnar )
+   {
+      writer.Key("DATA_LAYOUT");
+      writer.String("COLUMNAR");
+      writer.Key("UEL_ENCODING");
+      writer.String(options.dictionary ? "DICTIONARY" : "LABEL");
+   }
+   // DATA tables with LAYOUT BASE are to be taken from this export
+   if( options.base != NULL )
+   {
+      writer.Key("BASE");
+      writer.String(pathFromOutput(options.base));
+   }
+   // the other sections are in this file, which has to have this content hash
+   if( options.structure != NULL )
+   {
+      writer.Key("STRUCTURE");
+      writer.String(pathFromOutput(options.structure));
+      writer.Key("FINGERPRINT");
+      writer.String(fingerprint);
+   }
    writer.EndObject();
+   outindex.end(outindex.sections);
 
-   printInputDataModel(writer, dct);
+   if( options.structure == NULL )
+      printInputDataModel(writer);
 
-   // TODO OutputDataModel
+   if( options.solution && options.structure == NULL )
+      printOutputDataModel(writer);
 
    writer.Key("DATA");
+   outindex.begin(outindex.sections, "DATA");
    writer.StartObject();
-   printSymbolData(writer, gmo, dct);
-   printCoefficientData(writer, dct);
+   printSymbolData(writer);
+   printCoefficientData(writer);
    writer.EndObject();
+   outindex.end(outindex.sections);
+
+   if( options.solution )
+      printOutputData(writer);
+
+   if( options.structure == NULL )
+   {
+      printSymbols(writer, Symbol::Variable);
+      printSymbols(writer, Symbol::Constraint);
+      printSymbols(writer, Symbol::Objective);
+      printCoefficients(writer);
+   }
 
-   printSymbols(writer, gmo, dct, Symbol::Variable);
-   printSymbols(writer, gmo, dct, Symbol::Constraint);
-   printSymbols(writer, gmo, dct, Symbol::Objective);
-   printCoefficients(writer, dct);
+   if( options.hashes )
+   {
+      writer.Key("HASHES");
+      outindex.begin(outindex.sections, "HASHES");
+      writer.StartObject();
+      for( auto& h : tablehashes )
+      {
+         writer.Key(h.first);
+         writer.String(h.second);
+      }
+      writer.EndObject();
+      outindex.end(outindex.sections);
+   }
 
    writer.EndObject();
-   std::cout << s.GetString() << std::endl;
+   os.Put('\n');
+
+   if( !os.close() || writeerror )
+      goto TERMINATE;
+
+   if( options.index && !outindex.write((std::string(options.outfile) + ".idx").c_str()) )
+      goto TERMINATE;
+
+   // the output is complete, failing to cache it only costs a conversion later
+   if( cacheable )
+      cache.store(options.outfile, cachesuffixes);
+
+   if( options.binary && !binarydata.close([](int uel) { return model.uelLabel(uel); }) )
+      goto TERMINATE;
+
+   if( options.lowmem )
+   {
+      jacgmo = NULL;
+      freeGMS(&gmo, &gev);
+   }
+
+   reportStats("write");
 
    }
 
 
    rc = EXIT_SUCCESS;
-   freeGMS(&gmo, &gev);
 
 TERMINATE:
 
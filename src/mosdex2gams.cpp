@@ -1,77 +1,101 @@
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <cctype>
 #include <cassert>
+#include <cmath>
+#include <limits>
 #include <iostream>
 
 #include <vector>
 #include <set>
 #include <string>
 #include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <thread>
 
 #define RAPIDJSON_HAS_STDSTRING 1
-#include "rapidjson/filereadstream.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/document.h"
-#include "rapidjson/error/en.h"
+
+#include "mosdexio.h"
+#include "mosdexread.h"
+
+#include "gdxcc.h"
 
 using namespace rapidjson;
 
-std::vector<std::string> getDomain(
-   Document&   d,
-   std::string entity,
-   std::string name
-)
-{
-   assert(d.IsObject());
+// mapping sets that pair each label of a constraint domain with the same label of a variable domain,
+// by (constraint domain, variable domain); a sum over a mapping set makes GAMS generate a conditioned
+// term in time linear in its entries, while a sum with $sameas enumerates both domains
+static std::map<std::pair<std::string, std::string>, std::string> mappings;
 
-   std::vector<std::string> dom;
+// labels of the DATA tables, interned: id of each label, and its quoted GAMS form by id, in order of first appearance
+static std::unordered_map<std::string, uint32_t> uelids;
+static std::vector<std::string> uelquoted;
 
-   std::string indexname;
-   if( entity == "VARIABLE" )
-   {
-      auto& vars = d["VARIABLES"];
-      for( Value::ConstValueIterator itr = vars.Begin(); itr != vars.End(); ++itr )
-      {
-         if( name == (*itr)["NAME"].GetString() )
-         {
-            indexname = (*itr)["INDEX"].GetString();
-            break;
-         }
-      }
-   }
-   else if( entity == "CONSTRAINT" )
-   {
-      auto& vars = d["CONSTRAINTS"];
-      for( Value::ConstValueIterator itr = vars.Begin(); itr != vars.End(); ++itr )
-      {
-         if( name == (*itr)["NAME"].GetString() )
-         {
-            indexname = (*itr)["INDEX"].GetString();
-            break;
-         }
-      }
-   }
-   else if( entity == "INDEX" )
-   {
-      indexname = name;
-   }
+// ids of the labels of each selected DATA table, row after row, as interned by processUels,
+// so that processData puts rows together from uelquoted without looking up the labels again
+static std::map<std::string, std::vector<uint32_t> > tableuelids;
 
-   assert(!indexname.empty());
+// labels of the domains that appear in mappings, collected from the DATA tables, by id
+static std::map<std::string, std::set<uint32_t> > domainlabels;
 
-   auto& inputdata = d["INPUT_DATA_MODEL"][indexname];
-   for( Value::ConstMemberIterator itr = inputdata.MemberBegin(); itr != inputdata.MemberEnd(); ++itr )
+// a label quoted for GAMS; labels that contain a single quote are put in double quotes
+static
+std::string quoteLabel(
+   const char* label
+   )
+{
+   char quote = strchr(label, '\'') != NULL ? '"' : '\'';
+   return quote + std::string(label) + quote;
+}
+
+// id of a label, assigned on first use
+static
+uint32_t internUel(
+   const char* label
+   )
+{
+   auto it = uelids.find(label);
+   if( it != uelids.end() )
+      return it->second;
+
+   uint32_t id = (uint32_t)uelquoted.size();
+   uelids.emplace(label, id);
+   uelquoted.push_back(quoteLabel(label));
+   return id;
+}
+
+// names the mapping sets needed by the coefficients of selected constraints
+static
+void collectMappings(
+   Document& d
+   )
+{
+   if( !d.HasMember("COEFFICIENTS") )
+      return;
+
+   auto& coefs = d["COEFFICIENTS"];
+   for( Value::ConstValueIterator itr = coefs.Begin(); itr != coefs.End(); ++itr )
    {
-      // keynames are identfied by leading '*'
-      if( *itr->name.GetString() == '*' )
+      if( !itr->HasMember("CONSTRAINTS") || !itr->HasMember("CONDITION") || !isSelected((*itr)["CONSTRAINTS"].GetString()) )
+         continue;
+
+      for( auto& p : parseCondition((*itr)["CONDITION"].GetString()) )
       {
-         assert(itr->value.IsString());
-         assert(itr->value == "String");
+         auto key = std::make_pair(p.second, p.first);
+         if( mappings.count(key) > 0 )
+            continue;
 
-         dom.push_back(std::string(itr->name.GetString() + 1));
+         std::string name = "map_" + std::to_string(mappings.size() + 1);
+         mappings[key] = name;
+         domainlabels[p.first];
+         domainlabels[p.second];
       }
    }
-
-   return dom;
 }
 
 int processInputDataModel(
@@ -93,24 +117,9 @@ int processInputDataModel(
    {
        //out << "Type of member " << itr->name.GetString() << " is " << itr->value.GetType() << std::endl;
       assert(itr->value.IsObject());
-      for( Value::ConstMemberIterator itr2 = itr->value.MemberBegin(); itr2 != itr->value.MemberEnd(); ++itr2 )
-      {
-         // keynames are identfied by leading '*'
-         if( *itr2->name.GetString() == '*' )
-         {
-            assert(itr2->value.IsString());
-            assert(itr2->value == "String");
-
-            keynames.insert(std::string(itr2->name.GetString() + 1));
-         }
-         else
-         {
-            assert(itr2->value.IsString());
-            assert(itr2->value == "Double");
-
-            othernames.insert(itr2->name.GetString());
-         }
-      }
+      const Schema& schema = addSchema(itr->name.GetString(), itr->value);
+      keynames.insert(schema.keys.begin(), schema.keys.end());
+      othernames.insert(schema.other.begin(), schema.other.end());
    }
 
    // declare sets
@@ -179,10 +188,76 @@ int processInputDataModel(
    return 0;
 }
 
-int processData(
+// interns the labels of the selected DATA tables and declares them all in one set, in the order they first appear,
+// so that GAMS knows each label before the tables use it and its order is fixed up front
+// also collects the labels of the domains of the mapping sets
+int processUels(
    std::ostream&  out,
    Document&      d
    )
+{
+   auto& data = d["DATA"];
+   for( Value::ConstMemberIterator itr = data.MemberBegin(); itr != data.MemberEnd(); ++itr )
+   {
+      if( !isSelected(itr->name.GetString()) )
+         continue;
+
+      const std::vector<std::string>& keys = getSchema(d, itr->name.GetString()).keys;
+
+      std::vector<std::set<uint32_t>*> collect(keys.size(), NULL);
+      for( size_t k = 0; k < keys.size(); ++k )
+         if( domainlabels.count(keys[k]) > 0 )
+            collect[k] = &domainlabels[keys[k]];
+
+      std::vector<uint32_t>& ids = tableuelids[itr->name.GetString()];
+      forEachRow(d, itr->value, keys, std::vector<std::string>(),
+         [&](const std::vector<const char*>& labels, const std::vector<double>&)
+         {
+            for( size_t k = 0; k < keys.size(); ++k )
+            {
+               uint32_t id = internUel(labels[k]);
+               ids.push_back(id);
+               if( collect[k] != NULL )
+                  collect[k]->insert(id);
+            }
+         });
+   }
+
+   if( uelquoted.empty() )
+      return 0;
+
+   out << "Set mosdex_uels /\n";
+   for( const std::string& uel : uelquoted )
+   {
+      out.write("  ", 2);
+      out.write(uel.data(), uel.size());
+      out.put('\n');
+   }
+   out << "/;" << std::endl;
+
+   return 0;
+}
+
+// prints the last error of a GDX file
+static
+void gdxPrintError(
+   gdxHandle_t gdx,
+   const char* what
+   )
+{
+   char msg[GMS_SSSIZE];
+   gdxErrorStr(gdx, gdxGetLastError(gdx), msg);
+   std::cerr << "Error writing " << what << " to GDX file: " << msg << std::endl;
+}
+
+// writes the DATA tables as parameters and sets, with the rows inline,
+// or, if gdx is given, into the GDX file gdxfile, which the output then loads from
+int processData(
+   std::ostream&  out,
+   Document&      d,
+   gdxHandle_t    gdx,
+   const char*    gdxfile
+   )
 {
    assert(d.IsObject());
    assert(d.HasMember("DATA"));
@@ -190,88 +265,169 @@ int processData(
    auto& data = d["DATA"];
    assert(data.IsObject());
 
+   if( gdx != NULL )
+      out << "$gdxIn " << gdxfile << std::endl;
+
    for( Value::ConstMemberIterator itr = data.MemberBegin(); itr != data.MemberEnd(); ++itr )
    {
-      auto& decl = d["INPUT_DATA_MODEL"][itr->name];
+      if( !isSelected(itr->name.GetString()) )
+         continue;
+
+      const Schema& schema = getSchema(d, itr->name.GetString());
+      const std::vector<std::string>& keys = schema.keys;
+      const std::vector<std::string>& other = schema.other;
 
       std::string param(itr->name.GetString());
       param += "(";
-
-      std::vector<std::string> keys;
-      std::set<std::string> other;
-
-      bool first = true;
-      for( Value::ConstMemberIterator itr2 = decl.MemberBegin(); itr2 != decl.MemberEnd(); ++itr2 )
+      for( size_t k = 0; k < keys.size(); ++k )
       {
-         // keynames are identfied by leading '*'
-         if( *itr2->name.GetString() == '*' )
-         {
-            assert(itr2->value.IsString());
-            assert(itr2->value == "String");
+         if( k > 0 )
+            param += ", ";
+         param += keys[k] + '<';
+      }
 
-            if( !first )
-               param += ", ";
-            else
-               first = false;
+      if( !schema.isset )
+         param = "Parameter " + param + ", cols)";
+      else
+         param = "Set " + param + ")";
 
-            param += std::string(itr2->name.GetString() + 1) + '<';
+      if( gdx != NULL )
+      {
+         out << param << ";" << std::endl;
+         out << "$load " << itr->name.GetString() << std::endl;
 
-            keys.push_back(itr2->name.GetString() + 1);
+         int dim = (int)keys.size() + (schema.isset ? 0 : 1);
+         if( dim > GMS_MAX_INDEX_DIM )
+         {
+            std::cerr << "DATA table " << itr->name.GetString() << " has too many columns for GDX" << std::endl;
+            return 1;
          }
-         else
+         if( !gdxDataWriteStrStart(gdx, itr->name.GetString(), "", dim, schema.isset ? GMS_DT_SET : GMS_DT_PAR, 0) )
          {
-            assert(itr2->value.IsString());
-            assert(itr2->value == "Double");
-
-            other.insert(itr2->name.GetString());
+            gdxPrintError(gdx, itr->name.GetString());
+            return 1;
          }
       }
-      if( !other.empty() )
-      {
-         param += ", cols) /";
-         out << "Parameter " << param << std::endl;
-      }
       else
       {
-         param += ") /";
-         out << "Set " << param << std::endl;
+         out << param << " /" << std::endl;
       }
+      bool gdxok = true;
 
-      assert(itr->value.IsArray());
-      for( Value::ConstValueIterator itr2 = itr->value.Begin(); itr2 != itr->value.End(); ++itr2 )
-      {
-         assert(itr2->IsObject());
-         std::string keystring;
-         bool first = true;
-         for( auto& key : keys )
-         {
-            assert(itr2->HasMember(key));
+      // key columns whose labels are needed for mapping sets; written inline, the labels were collected by processUels
+      std::vector<std::set<uint32_t>*> collect(keys.size(), NULL);
+      for( size_t k = 0; k < keys.size() && gdx != NULL; ++k )
+         if( domainlabels.count(keys[k]) > 0 )
+            collect[k] = &domainlabels[keys[k]];
 
-            if( !first )
-               keystring += '.';
-            else
-               first = false;
+      // value columns as the last label of a row: ".'col' "
+      std::vector<std::string> colsuffix;
+      for( auto& o : other )
+         colsuffix.push_back('.' + quoteLabel(o.c_str()) + ' ');
 
-            keystring += '\'';
-            keystring += (*itr2)[key].GetString();
-            keystring += '\'';
-         }
+      // ids of the labels of the rows, which come in the same order as in processUels
+      const std::vector<uint32_t>* ids = gdx == NULL ? &tableuelids.at(itr->name.GetString()) : NULL;
+      size_t idpos = 0;
 
-         if( other.empty() )
-         {
-            out << "  " << keystring << std::endl;
-         }
-         else
+      std::string keystring;
+      char buf[32];
+
+      forEachRow(d, itr->value, keys, other,
+         [&](const std::vector<const char*>& labels, const std::vector<double>& vals)
          {
-            for( auto& o : other )
+            if( gdx != NULL )
+            {
+               for( size_t k = 0; k < keys.size(); ++k )
+                  if( collect[k] != NULL )
+                     collect[k]->insert(internUel(labels[k]));
+
+               const char* keystrs[GMS_MAX_INDEX_DIM];
+               gdxValues_t gdxvals = { 0.0 };
+               std::copy(labels.begin(), labels.end(), keystrs);
+
+               if( schema.isset )
+               {
+                  gdxok = gdxok && gdxDataWriteStr(gdx, keystrs, gdxvals);
+                  return;
+               }
+
+               size_t o = 0;
+               for( auto oitr = other.begin(); oitr != other.end(); ++oitr, ++o )
+               {
+                  if( !std::isnan(vals[o]) )
+                  {
+                     keystrs[labels.size()] = oitr->c_str();
+                     gdxvals[GMS_VAL_LEVEL] = vals[o];
+                     gdxok = gdxok && gdxDataWriteStr(gdx, keystrs, gdxvals);
+                  }
+               }
+               return;
+            }
+
+            // labels are interned by processUels, so a row is put together from their quoted forms
+            keystring.assign("  ", 2);
+            for( size_t k = 0; k < labels.size(); ++k )
+            {
+               if( k > 0 )
+                  keystring += '.';
+               keystring += uelquoted[(*ids)[idpos++]];
+            }
+
+            if( schema.isset )
+            {
+               keystring += '\n';
+               out.write(keystring.data(), keystring.size());
+               return;
+            }
+
+            for( size_t o = 0; o < other.size(); ++o )
             {
-               if( itr2->HasMember(o) )
+               if( !std::isnan(vals[o]) )
                {
-                  out << "  " << keystring << ".'" << o << "' " << (*itr2)[o].GetDouble() << std::endl;
+                  out.write(keystring.data(), keystring.size());
+                  out.write(colsuffix[o].data(), colsuffix[o].size());
+                  int len = snprintf(buf, sizeof(buf), "%.17g\n", vals[o]);
+                  out.write(buf, len);
                }
             }
+         });
+
+      if( gdx != NULL )
+      {
+         if( !gdxok || !gdxDataWriteDone(gdx) )
+         {
+            gdxPrintError(gdx, itr->name.GetString());
+            return 1;
          }
       }
+      else
+      {
+         out << "/;" << std::endl;
+         assert(idpos == ids->size());
+         tableuelids.erase(itr->name.GetString());
+      }
+   }
+
+   if( gdx != NULL )
+      out << "$gdxIn" << std::endl;
+
+   return 0;
+}
+
+// declares the mapping sets, with the labels that both domains have
+int processMappings(
+   std::ostream&  out
+   )
+{
+   for( auto& m : mappings )
+   {
+      const std::set<uint32_t>& condom = domainlabels[m.first.first];
+      const std::set<uint32_t>& vardom = domainlabels[m.first.second];
+
+      out << "Set " << m.second << "(" << m.first.first << ", " << m.first.second << ") /" << std::endl;
+      for( uint32_t id : condom )
+         if( vardom.count(id) > 0 )
+            out << "  " << uelquoted[id] << '.' << uelquoted[id] << '\n';
       out << "/;" << std::endl;
    }
 
@@ -294,33 +450,21 @@ int processVariables(
       auto& var = *itr;
       assert(var.IsObject());
 
-      std::string vardomstr;
-
-      auto& decl = d["INPUT_DATA_MODEL"][var["INDEX"]];
-
-      std::vector<std::string> keys;
-      std::set<std::string> other;
+      if( !isSelected(var["NAME"].GetString()) )
+         continue;
 
-      bool first = true;
-      for( Value::ConstMemberIterator itr2 = decl.MemberBegin(); itr2 != decl.MemberEnd(); ++itr2 )
+      if( var["INDEX"] == "self" )
       {
-         // keynames are identfied by leading '*'
-         if( *itr2->name.GetString() == '*' )
-         {
-            assert(itr2->value.IsString());
-            assert(itr2->value == "String");
+         std::cerr << "Variable " << var["NAME"].GetString() << " is scalar, which is not supported" << std::endl;
+         return 1;
+      }
 
-            if( !first )
-               vardomstr += ", ";
-            else
-               first = false;
+      const std::string& vardomstr = getSchema(d, var["INDEX"].GetString()).domstr;
 
-            vardomstr += std::string(itr2->name.GetString() + 1);
-         }
-      }
-      if( var["TYPE"] == "INTEGER")
+      // the type is case-insensitive, as in forEachVariableEntry
+      if( var.HasMember("TYPE") && strcasecmp(var["TYPE"].GetString(), "integer") == 0 )
          out << "Integer ";   // FIXME this implies a lower bound of 0
-      else if( var["TYPE"] == "BINARY")
+      else if( var.HasMember("TYPE") && strcasecmp(var["TYPE"].GetString(), "binary") == 0 )
          out << "Binary ";
       out << "Variable " << var["NAME"].GetString() << '(' + vardomstr << ");" << std::endl;
 
@@ -331,8 +475,8 @@ int processVariables(
          {
             out << var["NAME"].GetString() << ".lo(" << vardomstr << ") = ";
             auto& lb = bounds["LOWER"];
-            assert(lb.IsDouble() || lb.IsString());  // integer?
-            if( lb.IsDouble() )
+            assert(lb.IsNumber() || lb.IsString());
+            if( lb.IsNumber() )
             {
                 out << lb.GetDouble();
             }
@@ -355,8 +499,8 @@ int processVariables(
          {
             out << var["NAME"].GetString() << ".up(" << vardomstr << ") = ";
             auto& ub = bounds["UPPER"];
-            assert(ub.IsDouble() || ub.IsString());  // integer?
-            if( ub.IsDouble() )
+            assert(ub.IsNumber() || ub.IsString());
+            if( ub.IsNumber() )
             {
                 out << ub.GetDouble();
             }
@@ -401,18 +545,19 @@ int processConstraints(
       auto& con = *itr;
       assert(con.IsObject());
 
-      std::vector<std::string> condom = getDomain(d, "INDEX", con["INDEX"].GetString());
+      if( !isSelected(con["NAME"].GetString()) )
+         continue;
 
-      std::string condomstr;
-      bool first = true;
-      for( auto& d : condom )
+      if( con["INDEX"] == "self" )
       {
-         if( !first )
-            condomstr += ", ";
-         else
-            first = false;
-         condomstr += d;
+         std::cerr << "Constraint " << con["NAME"].GetString() << " is scalar, which is not supported" << std::endl;
+         return 1;
       }
+
+      const Schema& conschema = getSchema(d, con["INDEX"].GetString());
+      const std::vector<std::string>& condom = conschema.keys;
+      const std::string& condomstr = conschema.domstr;
+
       //assert(con["TYPE"] == "LINEAR");
       out << "Equation " << con["NAME"].GetString() << '(' + condomstr << ");" << std::endl;
 
@@ -426,29 +571,31 @@ int processConstraints(
          if( strcmp((*coefitr)["CONSTRAINTS"].GetString(), con["NAME"].GetString()) != 0 )
             continue;
 
-         out << " +";
-         out << (*coefitr)["ENTRIES"].GetString() << " * ";  // TODO this needs more processing
-
          std::string var = (*coefitr)["VARIABLES"].GetString();
-         std::vector<std::string> vardom = getDomain(d, "VARIABLE", var);
+         const std::vector<std::string>& vardom = getSymbolSchema(d, "VARIABLES", var).keys;
 
-
-         // process matching of variable and equation indices
-         // FIXME assumes very particular format
-         std::string sameasstr;
-         if( coefitr->HasMember("CONDITION") )
+         // a number if all coefficients of the block are the same, else a column "table.val" of a DATA table
+         // whose keys are the constraint domains and the variable domains that are not matched by the CONDITION
+         std::string entries;
+         bool sparse = !(*coefitr)["ENTRIES"].IsNumber();
+         if( !sparse )
          {
-            std::string cond = (*coefitr)["CONDITION"].GetString();
-            size_t seppos = cond.find(" == ");
-            assert(seppos != std::string::npos);
-
-            std::string first(cond, 0, seppos);
-            std::string second(cond, seppos+4);
-
-            first = std::string(first, first.find(".")+1);
-            second = std::string(second, second.find(".")+1);
-
-            sameasstr = std::string("$sameas(") + first + "," + second + ")";
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", (*coefitr)["ENTRIES"].GetDouble());
+            entries = buf;
+         }
+         else
+         {
+            std::string col = (*coefitr)["ENTRIES"].GetString();
+            size_t dotpos = col.find('.');
+            assert(dotpos != std::string::npos);
+            std::string table(col, 0, dotpos);
+            col = std::string(col, dotpos+1);
+
+            entries = table + "(";
+            for( auto& k : getSchema(d, table).keys )
+               entries += k + ",";
+            entries += "'" + col + "')";
          }
 
          // check which of the constraints domains appear in variables domains
@@ -464,24 +611,59 @@ int processConstraints(
             }
          }
 
-         if( ncontrolled < vardom.size() )
+         // variable domains matched to constraint domains by the CONDITION are summed over where their mapping set
+         // holds, see collectMappings; the constraint domains are controlled by the equation already
+         std::vector<std::string> sumidx;
+         std::vector<std::string> sumcond;
+         if( coefitr->HasMember("CONDITION") )
+         {
+            for( auto& p : parseCondition((*coefitr)["CONDITION"].GetString()) )
+            {
+               ptrdiff_t pos = std::find(vardom.begin(), vardom.end(), p.first) - vardom.begin();
+               if( pos == (int)vardom.size() || controlled[pos] )
+                  continue;
+               controlled[pos] = true;
+               ++ncontrolled;
+
+               sumidx.push_back(p.first);
+               sumcond.push_back(mappings.at(std::make_pair(p.second, p.first)) + "(" + p.second + "," + p.first + ")");
+            }
+         }
+
+         for( size_t i = 0; i < vardom.size(); ++i )
+            if( !controlled[i] )
+               sumidx.push_back(vardom[i]);
+
+         // a sum over a table runs over its nonzeros only, so generation scales with the number of coefficients
+         if( sparse )
+            sumcond.push_back(entries);
+
+         out << " +";
+         if( !sumidx.empty() )
          {
             out << "sum((";
             bool first = true;
-            for( size_t i = 0; i < vardom.size(); ++i )
+            for( auto& idx : sumidx )
             {
-               if( !controlled[i] )
-               {
-                  if( !first )
-                     out << ",";
-                  else
-                     first = false;
-                  out << vardom[i];
-               }
+               if( !first )
+                  out << ",";
+               else
+                  first = false;
+               out << idx;
             }
-            out << ")" << sameasstr << ",";
+            out << ")";
+            if( sumcond.size() == 1 )
+               out << "$" << sumcond[0];
+            else if( !sumcond.empty() )
+            {
+               out << "$(";
+               for( size_t i = 0; i < sumcond.size(); ++i )
+                  out << (i > 0 ? " and " : "") << sumcond[i];
+               out << ")";
+            }
+            out << ",";
          }
-         out << var << "(";
+         out << entries << " * " << var << "(";
          bool first = true;
          for( auto& d : vardom )
          {
@@ -492,7 +674,7 @@ int processConstraints(
             out << d;
          }
          out << ")";
-         if( ncontrolled < vardom.size() )
+         if( !sumidx.empty() )
             out << ")";
 
       }
@@ -508,8 +690,8 @@ int processConstraints(
          if( bounds.HasMember("LOWER") )
          {
             auto& lb = bounds["LOWER"];
-            assert(lb.IsDouble() || lb.IsString());  // integer?
-            if( lb.IsDouble() )
+            assert(lb.IsNumber() || lb.IsString());
+            if( lb.IsNumber() )
             {
                lbstr = std::to_string(lb.GetDouble());
             }
@@ -530,8 +712,8 @@ int processConstraints(
          if( bounds.HasMember("UPPER") )
          {
             auto& ub = bounds["UPPER"];
-            assert(ub.IsDouble() || ub.IsString());  // integer?
-            if( ub.IsDouble() )
+            assert(ub.IsNumber() || ub.IsString());
+            if( ub.IsNumber() )
             {
                ubstr = std::to_string(ub.GetDouble());
             }
@@ -566,7 +748,8 @@ int processConstraints(
          }
          else
          {
-            assert("RANGED CONSTRAINTS NOT ALLOWED" == NULL);
+            std::cerr << "Constraint " << con["NAME"].GetString() << " has lower and upper bound, ranged constraints are not supported" << std::endl;
+            return 1;
          }
       }
 
@@ -581,34 +764,111 @@ int main(
    char** argv
 )
 {
-   if( argc <= 1 )
+   const char* infile = NULL;
+   const char* gdxfile = NULL;
+   const char* structure = NULL;
+   Compression compression = COMPRESSION_NONE;
+   bool compressionset = false;
+   unsigned nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+   int argi = 1;
+   for( ; argi < argc - 1 && argv[argi][0] == '-'; ++argi )
    {
-      std::cerr << "Usage: " << argv[0] << " <file.mosdex>" << std::endl;
-      return EXIT_FAILURE;
+      if( strcmp(argv[argi], "-z") == 0 && argi + 1 < argc - 1 )
+      {
+         if( !compressionFromName(argv[++argi], &compression) )
+         {
+            std::cerr << "Unknown compression " << argv[argi] << std::endl;
+            return EXIT_FAILURE;
+         }
+         compressionset = true;
+      }
+      else if( strcmp(argv[argi], "-gdx") == 0 && argi + 1 < argc - 1 )
+         gdxfile = argv[++argi];
+      else if( strcmp(argv[argi], "-structure") == 0 && argi + 1 < argc - 1 )
+         structure = argv[++argi];
+      else if( strcmp(argv[argi], "-threads") == 0 && argi + 1 < argc - 1 )
+         nthreads = std::max(atoi(argv[++argi]), 1);
+      else if( strcmp(argv[argi], "-select") == 0 && argi + 1 < argc - 1 )
+      {
+         std::string names = argv[++argi];
+         size_t pos = 0;
+         while( pos <= names.size() )
+         {
+            size_t comma = names.find(',', pos);
+            if( comma == std::string::npos )
+               comma = names.size();
+            if( comma > pos )
+               selection.insert(names.substr(pos, comma - pos));
+            pos = comma + 1;
+         }
+      }
+      else
+         break;
    }
 
-   FILE *fp = fopen(argv[1], "r");
-   if( fp == NULL )
+   if( argi != argc - 1 )
    {
-       std::cerr << "File " << argv[1] << " not found" << std::endl;
-       return EXIT_FAILURE;
+      std::cerr << "Usage: " << argv[0] << " [options] <file.mosdex>" << std::endl;
+      std::cerr << "Options:" << std::endl;
+      std::cerr << "  -z <comp>           input is compressed with none, gzip, or zstd (default: by extension .gz, .zst)" << std::endl;
+      std::cerr << "  -select <name,...>  convert only these variables, constraints, and DATA tables" << std::endl;
+      std::cerr << "                      if <file.mosdex>.idx exists, only the needed parts are read" << std::endl;
+      std::cerr << "  -threads <n>        number of threads for reading JSON-Lines DATA files (default: all cores)" << std::endl;
+      std::cerr << "  -structure <file>   take the sections other than DATA from <file> instead of the structure file" << std::endl;
+      std::cerr << "                      that <file.mosdex> refers to; its fingerprint has to match" << std::endl;
+      std::cerr << "  -gdx <file.gdx>     write DATA tables to a GDX file and $load them, instead of inline" << std::endl;
+      return EXIT_FAILURE;
    }
-
-   char readBuffer[65536];
-   FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+   infile = argv[argi];
+   if( !compressionset )
+      compression = compressionFromFilename(infile);
 
    Document d;
-   if( d.ParseStream(is).HasParseError() )
+   if( !loadMosdex(d, infile, compression, nthreads, structure) )
+      return EXIT_FAILURE;
+
+   collectMappings(d);
+
+   gdxHandle_t gdx = NULL;
+   if( gdxfile != NULL )
    {
-      std::cerr << "Error(offset " << d.GetErrorOffset() << "): " << GetParseError_En(d.GetParseError()) << std::endl;
+      char msg[GMS_SSSIZE];
+      int errnr;
+      if( !gdxCreateD(&gdx, GAMSDIR, msg, sizeof(msg)) )
+      {
+         std::cerr << "Could not load GDX library: " << msg << std::endl;
+         return EXIT_FAILURE;
+      }
+      if( !gdxOpenWrite(gdx, gdxfile, "mosdex2gams", &errnr) )
+      {
+         gdxErrorStr(gdx, errnr, msg);
+         std::cerr << "Could not open " << gdxfile << " for writing: " << msg << std::endl;
+         gdxFree(&gdx);
+         return EXIT_FAILURE;
+      }
    }
 
-   fclose(fp);
-
    processInputDataModel(std::cout, d);
-   processData(std::cout, d);
-   processVariables(std::cout, d);
-   processConstraints(std::cout, d);
+   if( gdx == NULL )
+      processUels(std::cout, d);
+   int rc = processData(std::cout, d, gdx, gdxfile);
+
+   if( gdx != NULL )
+   {
+      if( gdxClose(gdx) != 0 )
+      {
+         std::cerr << "Error writing " << gdxfile << std::endl;
+         rc = 1;
+      }
+      gdxFree(&gdx);
+   }
+   if( rc != 0 )
+      return EXIT_FAILURE;
+
+   processMappings(std::cout);
+   if( processVariables(std::cout, d) != 0 || processConstraints(std::cout, d) != 0 )
+      return EXIT_FAILURE;
 
    return EXIT_SUCCESS;
 }
\ No newline at end of file
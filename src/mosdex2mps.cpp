@@ -0,0 +1,600 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+
+#include "mosdexio.h"
+#include "mosdexread.h"
+
+using namespace rapidjson;
+
+// writes a MOSDEX document as gams2mosdex writes it as a free MPS or CPLEX LP file,
+// expanding the coefficient blocks directly instead of going through a GAMS model as with mosdex2gams
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+class Row
+{
+public:
+   std::string name;
+
+   // N (objective or free), E, G, or L, as in MPS
+   char sense = 'N';
+   double rhs = 0.0;
+
+   // for ranged rows, the difference of upper and lower bound of a G row, else 0
+   double range = 0.0;
+};
+
+class Column
+{
+public:
+   std::string name;
+   double lb = 0.0;
+   double ub = INF;
+
+   // C, I, or B
+   char type = 'C';
+};
+
+static std::vector<Row> rows;
+static std::vector<Column> cols;
+
+// whether there is an objective, which is then rows[0]
+static bool hasobjective = false;
+static bool maximize = false;
+
+// row or column of each entry of a constraint or variable, by symbol name, then by labelsKey of its labels
+static std::map<std::string, std::unordered_map<std::string, int> > rowindex;
+static std::map<std::string, std::unordered_map<std::string, int> > colindex;
+
+// selected constraints, variables, and objective, by name
+static std::map<std::string, const Value*> symbols;
+
+// coefficients in the order they are expanded
+static std::vector<int> coefrow;
+static std::vector<int> coefcol;
+static std::vector<double> coefval;
+
+static
+std::string labelsKey(
+   const std::vector<const char*>& labels
+   )
+{
+   std::string key;
+   for( size_t i = 0; i < labels.size(); ++i )
+   {
+      if( i > 0 )
+         key += '\1';
+      key += labels[i];
+   }
+   return key;
+}
+
+// name of a row or column, e.g. x(i1,j2); characters that MPS or LP readers do not take are replaced by '_'
+static
+std::string entryName(
+   const std::string&              sym,
+   const std::vector<const char*>& labels
+   )
+{
+   std::string name = sym;
+   if( !labels.empty() )
+   {
+      name += '(';
+      for( size_t i = 0; i < labels.size(); ++i )
+      {
+         if( i > 0 )
+            name += ',';
+         name += labels[i];
+      }
+      name += ')';
+   }
+
+   for( char& c : name )
+      if( !isalnum((unsigned char)c) && strchr("_().,", c) == NULL )
+         c = '_';
+
+   return name;
+}
+
+static
+void addObjective(
+   Document& d
+   )
+{
+   if( !d.HasMember("DECISION_EXPRESSIONS") )
+      return;
+
+   auto& objs = d["DECISION_EXPRESSIONS"];
+   for( Value::ConstValueIterator itr = objs.Begin(); itr != objs.End(); ++itr )
+   {
+      auto& obj = *itr;
+      if( !obj.HasMember("SENSE") || !isSelected(obj["NAME"].GetString()) )
+         continue;
+
+      // only the first objective is kept, as the formats take one
+      if( hasobjective )
+      {
+         std::cerr << "Ignoring objective " << obj["NAME"].GetString() << ", only one is supported" << std::endl;
+         continue;
+      }
+
+      hasobjective = true;
+      maximize = obj["SENSE"] == "maximize";
+
+      rows.push_back(Row());
+      rows.back().name = entryName(obj["NAME"].GetString(), std::vector<const char*>());
+      rowindex[obj["NAME"].GetString()][""] = 0;
+      symbols[obj["NAME"].GetString()] = &obj;
+   }
+}
+
+static
+void addRows(
+   Document& d
+   )
+{
+   auto& cons = d["CONSTRAINTS"];
+   for( Value::ConstValueIterator itr = cons.Begin(); itr != cons.End(); ++itr )
+   {
+      std::string name = (*itr)["NAME"].GetString();
+      if( !isSelected(name) )
+         continue;
+
+      symbols[name] = &*itr;
+      std::unordered_map<std::string, int>& index = rowindex[name];
+
+      forEachConstraintEntry(d, *itr, [&](const std::vector<const char*>& labels, double lb, double ub)
+         {
+            Row row;
+            row.name = entryName(name, labels);
+            if( lb == ub )
+            {
+               row.sense = 'E';
+               row.rhs = lb;
+            }
+            else if( lb > -INF )
+            {
+               row.sense = 'G';
+               row.rhs = lb;
+               if( ub < INF )
+                  row.range = ub - lb;
+            }
+            else if( ub < INF )
+            {
+               row.sense = 'L';
+               row.rhs = ub;
+            }
+
+            index[labelsKey(labels)] = (int)rows.size();
+            rows.push_back(row);
+         });
+   }
+}
+
+static
+void addColumns(
+   Document& d
+   )
+{
+   auto& vars = d["VARIABLES"];
+   for( Value::ConstValueIterator itr = vars.Begin(); itr != vars.End(); ++itr )
+   {
+      std::string name = (*itr)["NAME"].GetString();
+      if( !isSelected(name) )
+         continue;
+
+      symbols[name] = &*itr;
+      std::unordered_map<std::string, int>& index = colindex[name];
+
+      forEachVariableEntry(d, *itr, [&](const std::vector<const char*>& labels, char type, double lb, double ub)
+         {
+            Column col;
+            col.name = entryName(name, labels);
+            col.type = type;
+            col.lb = lb;
+            col.ub = ub;
+
+            index[labelsKey(labels)] = (int)cols.size();
+            cols.push_back(col);
+         });
+   }
+}
+
+// expands each coefficient block of the selected constraints and variables into coefrow, coefcol, coefval
+static
+int addCoefficients(
+   Document& d
+   )
+{
+   auto& coefs = d["COEFFICIENTS"];
+   for( Value::ConstValueIterator itr = coefs.Begin(); itr != coefs.End(); ++itr )
+   {
+      if( !itr->HasMember("CONSTRAINTS") )
+         continue;
+
+      std::string conname = (*itr)["CONSTRAINTS"].GetString();
+      std::string varname = (*itr)["VARIABLES"].GetString();
+      if( rowindex.count(conname) == 0 || colindex.count(varname) == 0 )
+         continue;
+
+      const std::unordered_map<std::string, int>& conidx = rowindex[conname];
+      const std::unordered_map<std::string, int>& varidx = colindex[varname];
+
+      size_t missing = 0;
+      forEachCoefficient(d, *itr, *symbols[conname], *symbols[varname],
+         [&](const std::vector<const char*>& conlabels, const std::vector<const char*>& varlabels, double val)
+         {
+            auto r = conidx.find(labelsKey(conlabels));
+            auto c = varidx.find(labelsKey(varlabels));
+            if( r == conidx.end() || c == varidx.end() )
+            {
+               ++missing;
+               return;
+            }
+            coefrow.push_back(r->second);
+            coefcol.push_back(c->second);
+            coefval.push_back(val);
+         });
+
+      if( missing > 0 )
+      {
+         std::cerr << "Coefficients of " << varname << " in " << conname << ": " << missing << " entries refer to rows or columns that do not exist" << std::endl;
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+// positions of the coefficients grouped by column (bycol) or row, in the order they were added within a group
+// counting sort, as the group of each coefficient is known
+static
+void groupCoefficients(
+   bool                 bycol,
+   std::vector<size_t>& start,
+   std::vector<size_t>& order
+   )
+{
+   const std::vector<int>& group = bycol ? coefcol : coefrow;
+   size_t ngroups = bycol ? cols.size() : rows.size();
+
+   start.assign(ngroups + 1, 0);
+   for( int g : group )
+      ++start[g + 1];
+   for( size_t g = 0; g < ngroups; ++g )
+      start[g + 1] += start[g];
+
+   std::vector<size_t> next(start.begin(), start.end() - 1);
+   order.resize(group.size());
+   for( size_t i = 0; i < group.size(); ++i )
+      order[next[group[i]]++] = i;
+}
+
+static
+void put(
+   MosdexOutputStream& os,
+   const std::string&  str
+   )
+{
+   for( char c : str )
+      os.Put(c);
+}
+
+// shortest representation that reads back as the same double
+static
+std::string num(
+   double value
+   )
+{
+   char buf[32];
+   snprintf(buf, sizeof(buf), "%.15g", value);
+   if( strtod(buf, NULL) != value )
+      snprintf(buf, sizeof(buf), "%.17g", value);
+   return buf;
+}
+
+static
+void writeMps(
+   MosdexOutputStream& os,
+   const std::string&  probname
+   )
+{
+   put(os, "NAME " + probname + "\n");
+   if( maximize )
+      put(os, "OBJSENSE\n    MAX\n");
+
+   put(os, "ROWS\n");
+   if( !hasobjective )
+      put(os, " N obj\n");
+   for( auto& row : rows )
+      put(os, std::string(" ") + row.sense + " " + row.name + "\n");
+
+   std::vector<size_t> start;
+   std::vector<size_t> order;
+   groupCoefficients(true, start, order);
+
+   put(os, "COLUMNS\n");
+   bool inmarker = false;
+   for( size_t j = 0; j < cols.size(); ++j )
+   {
+      bool integer = cols[j].type != 'C';
+      if( integer != inmarker )
+      {
+         put(os, std::string("    MARKER 'MARKER' ") + (integer ? "'INTORG'" : "'INTEND'") + "\n");
+         inmarker = integer;
+      }
+
+      // a column without coefficients is still to be declared
+      if( start[j] == start[j+1] )
+         put(os, "    " + cols[j].name + " " + (hasobjective ? rows[0].name : std::string("obj")) + " 0\n");
+
+      for( size_t k = start[j]; k < start[j+1]; ++k )
+      {
+         size_t i = order[k];
+         put(os, "    " + cols[j].name + " " + rows[coefrow[i]].name + " " + num(coefval[i]) + "\n");
+      }
+   }
+   if( inmarker )
+      put(os, "    MARKER 'MARKER' 'INTEND'\n");
+
+   put(os, "RHS\n");
+   for( auto& row : rows )
+      if( row.sense != 'N' && row.rhs != 0.0 )
+         put(os, "    RHS " + row.name + " " + num(row.rhs) + "\n");
+
+   put(os, "RANGES\n");
+   for( auto& row : rows )
+      if( row.range != 0.0 )
+         put(os, "    RNG " + row.name + " " + num(row.range) + "\n");
+
+   // MPS defaults are [0,inf) for continuous and integer columns
+   put(os, "BOUNDS\n");
+   for( auto& col : cols )
+   {
+      if( col.type == 'B' && col.lb == 0.0 && col.ub == 1.0 )
+         put(os, " BV BND " + col.name + "\n");
+      else if( col.lb == col.ub )
+         put(os, " FX BND " + col.name + " " + num(col.lb) + "\n");
+      else if( col.lb == -INF && col.ub == INF )
+         put(os, " FR BND " + col.name + "\n");
+      else
+      {
+         if( col.lb == -INF )
+            put(os, " MI BND " + col.name + "\n");
+         else if( col.lb != 0.0 )
+            put(os, " LO BND " + col.name + " " + num(col.lb) + "\n");
+
+         if( col.ub < INF )
+            put(os, " UP BND " + col.name + " " + num(col.ub) + "\n");
+         else if( col.type != 'C' )
+            put(os, " PL BND " + col.name + "\n");
+      }
+   }
+
+   put(os, "ENDATA\n");
+}
+
+// terms of a row of an LP file, with line breaks every few terms
+static
+void writeLpTerms(
+   MosdexOutputStream&        os,
+   const std::vector<size_t>& start,
+   const std::vector<size_t>& order,
+   size_t                     r
+   )
+{
+   size_t linelen = 0;
+   for( size_t k = start[r]; k < start[r+1]; ++k )
+   {
+      size_t i = order[k];
+      std::string term = (coefval[i] < 0.0 ? " - " : " + ") + num(std::fabs(coefval[i])) + " " + cols[coefcol[i]].name;
+      if( linelen + term.size() > 200 )
+      {
+         put(os, "\n  ");
+         linelen = 0;
+      }
+      put(os, term);
+      linelen += term.size();
+   }
+
+   // LP readers want at least one term
+   if( start[r] == start[r+1] && !cols.empty() )
+      put(os, " 0 " + cols[0].name);
+}
+
+static
+void writeLp(
+   MosdexOutputStream& os,
+   const std::string&  probname
+   )
+{
+   std::vector<size_t> start;
+   std::vector<size_t> order;
+   groupCoefficients(false, start, order);
+
+   put(os, "\\Problem name: " + probname + "\n\n");
+   put(os, maximize ? "Maximize\n" : "Minimize\n");
+   if( hasobjective )
+   {
+      put(os, " " + rows[0].name + ":");
+      writeLpTerms(os, start, order, 0);
+      put(os, "\n");
+   }
+   else
+      put(os, " obj:\n");
+
+   // ranged rows are equalities with a range variable, free rows get an infinite lower bound
+   std::vector<std::string> rangevars;
+   put(os, "Subject To\n");
+   for( size_t r = hasobjective ? 1 : 0; r < rows.size(); ++r )
+   {
+      const Row& row = rows[r];
+      put(os, " " + row.name + ":");
+      writeLpTerms(os, start, order, r);
+      if( row.range != 0.0 )
+      {
+         rangevars.push_back("Rg" + row.name);
+         put(os, " - " + rangevars.back() + " = " + num(row.rhs) + "\n");
+         rangevars.back() += " <= " + num(row.range);
+      }
+      else if( row.sense == 'E' )
+         put(os, " = " + num(row.rhs) + "\n");
+      else if( row.sense == 'G' )
+         put(os, " >= " + num(row.rhs) + "\n");
+      else if( row.sense == 'L' )
+         put(os, " <= " + num(row.rhs) + "\n");
+      else
+         put(os, " >= -1e+30\n");
+   }
+
+   // LP defaults are [0,inf) for all columns, [0,1] for those in section Binary
+   put(os, "Bounds\n");
+   for( auto& col : cols )
+   {
+      if( col.type == 'B' && col.lb == 0.0 && col.ub == 1.0 )
+         continue;
+      if( col.lb == col.ub )
+         put(os, " " + col.name + " = " + num(col.lb) + "\n");
+      else if( col.lb == -INF && col.ub == INF )
+         put(os, " " + col.name + " free\n");
+      else if( col.lb != 0.0 || col.ub != INF )
+         put(os, " " + (col.lb == -INF ? std::string("-inf") : num(col.lb)) + " <= " + col.name + " <= " + (col.ub == INF ? std::string("+inf") : num(col.ub)) + "\n");
+   }
+   for( auto& rg : rangevars )
+      put(os, " 0 <= " + rg + "\n");
+
+   bool first = true;
+   for( auto& col : cols )
+      if( col.type == 'I' || (col.type == 'B' && (col.lb != 0.0 || col.ub != 1.0)) )
+      {
+         if( first )
+            put(os, "General\n");
+         first = false;
+         put(os, " " + col.name + "\n");
+      }
+
+   first = true;
+   for( auto& col : cols )
+      if( col.type == 'B' && col.lb == 0.0 && col.ub == 1.0 )
+      {
+         if( first )
+            put(os, "Binary\n");
+         first = false;
+         put(os, " " + col.name + "\n");
+      }
+
+   put(os, "End\n");
+}
+
+int main(
+   int    argc,
+   char** argv
+)
+{
+   const char* infile = NULL;
+   const char* outfile = NULL;
+   bool lp = false;
+   const char* structure = NULL;
+   Compression compression = COMPRESSION_NONE;
+   bool compressionset = false;
+   unsigned nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+   int argi = 1;
+   for( ; argi < argc - 1 && argv[argi][0] == '-'; ++argi )
+   {
+      if( strcmp(argv[argi], "-z") == 0 && argi + 1 < argc - 1 )
+      {
+         if( !compressionFromName(argv[++argi], &compression) )
+         {
+            std::cerr << "Unknown compression " << argv[argi] << std::endl;
+            return EXIT_FAILURE;
+         }
+         compressionset = true;
+      }
+      else if( strcmp(argv[argi], "-o") == 0 && argi + 1 < argc - 1 )
+         outfile = argv[++argi];
+      else if( strcmp(argv[argi], "-lp") == 0 )
+         lp = true;
+      else if( strcmp(argv[argi], "-structure") == 0 && argi + 1 < argc - 1 )
+         structure = argv[++argi];
+      else if( strcmp(argv[argi], "-threads") == 0 && argi + 1 < argc - 1 )
+         nthreads = std::max(atoi(argv[++argi]), 1);
+      else if( strcmp(argv[argi], "-select") == 0 && argi + 1 < argc - 1 )
+      {
+         std::string names = argv[++argi];
+         size_t pos = 0;
+         while( pos <= names.size() )
+         {
+            size_t comma = names.find(',', pos);
+            if( comma == std::string::npos )
+               comma = names.size();
+            if( comma > pos )
+               selection.insert(names.substr(pos, comma - pos));
+            pos = comma + 1;
+         }
+      }
+      else
+         break;
+   }
+
+   if( argi != argc - 1 )
+   {
+      std::cerr << "Usage: " << argv[0] << " [options] <file.mosdex>" << std::endl;
+      std::cerr << "Options:" << std::endl;
+      std::cerr << "  -o <file>           write to file instead of stdout, compressed if it ends in .gz or .zst" << std::endl;
+      std::cerr << "  -lp                 write CPLEX LP format instead of free MPS" << std::endl;
+      std::cerr << "  -z <comp>           input is compressed with none, gzip, or zstd (default: by extension .gz, .zst)" << std::endl;
+      std::cerr << "  -select <name,...>  convert only these variables, constraints, and objective" << std::endl;
+      std::cerr << "                      if <file.mosdex>.idx exists, only the needed parts are read" << std::endl;
+      std::cerr << "  -threads <n>        number of threads for reading JSON-Lines DATA files (default: all cores)" << std::endl;
+      std::cerr << "  -structure <file>   take the sections other than DATA from <file> instead of the structure file" << std::endl;
+      std::cerr << "                      that <file.mosdex> refers to; its fingerprint has to match" << std::endl;
+      return EXIT_FAILURE;
+   }
+   infile = argv[argi];
+   if( !compressionset )
+      compression = compressionFromFilename(infile);
+
+   Document d;
+   if( !loadMosdex(d, infile, compression, nthreads, structure) )
+      return EXIT_FAILURE;
+
+   addObjective(d);
+   addRows(d);
+   addColumns(d);
+   if( addCoefficients(d) != 0 )
+      return EXIT_FAILURE;
+
+   std::string probname = "mosdex";
+   if( d.HasMember("PROBLEM") && d["PROBLEM"].HasMember("NAME") )
+      probname = entryName(d["PROBLEM"]["NAME"].GetString(), std::vector<const char*>());
+
+   MosdexOutputStream os;
+   if( !os.open(outfile, outfile != NULL ? compressionFromFilename(outfile) : COMPRESSION_NONE) )
+      return EXIT_FAILURE;
+
+   if( lp )
+      writeLp(os, probname);
+   else
+      writeMps(os, probname);
+
+   if( !os.close() )
+   {
+      std::cerr << "Error writing " << (outfile != NULL ? outfile : "output") << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#include <cstring>
+#include <cassert>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mosdexbin.h"
+
+// the format is little-endian and read without copying, so the host has to be little-endian, too
+static
+bool isLittleEndian()
+{
+   uint32_t one = 1;
+   return *(const char*)&one == 1;
+}
+
+MosdexBinaryWriter::MosdexBinaryWriter()
+: fp(NULL), offset(0), failed(false)
+{ }
+
+MosdexBinaryWriter::~MosdexBinaryWriter()
+{
+   if( fp != NULL )
+      fclose(fp);
+}
+
+bool MosdexBinaryWriter::open(
+   const char* filename
+)
+{
+   assert(fp == NULL);
+
+   if( !isLittleEndian() )
+   {
+      std::cerr << "Binary DATA files can only be written on little-endian hosts" << std::endl;
+      return false;
+   }
+
+   fp = fopen(filename, "wb");
+   if( fp == NULL )
+   {
+      std::cerr << "Could not open " << filename << " for writing" << std::endl;
+      return false;
+   }
+
+   offset = 0;
+   failed = false;
+
+   // placeholder, written again in close()
+   MosdexBinHeader header;
+   memset(&header, 0, sizeof(header));
+   write(&header, sizeof(header));
+
+   return true;
+}
+
+void MosdexBinaryWriter::write(
+   const void* data,
+   size_t      size
+)
+{
+   if( fwrite(data, 1, size, fp) != size )
+      failed = true;
+   offset += size;
+}
+
+void MosdexBinaryWriter::align()
+{
+   static const char zeros[8] = { 0 };
+   if( offset % 8 != 0 )
+      write(zeros, 8 - offset % 8);
+}
+
+uint32_t MosdexBinaryWriter::writeTable(
+   size_t        nrows,
+   size_t        nkeys,
+   const int*    rowuels,
+   size_t        nvalues,
+   const double* vals
+)
+{
+   assert(fp != NULL);
+
+   MosdexBinTocEntry entry;
+   entry.nrows = nrows;
+   entry.nkeys = (uint32_t)nkeys;
+   entry.nvalues = (uint32_t)nvalues;
+   entry.offset = offset;
+   assert(offset % 8 == 0);
+
+   std::vector<uint32_t> codes(nrows);
+   for( size_t k = 0; k < nkeys; ++k )
+   {
+      for( size_t r = 0; r < nrows; ++r )
+      {
+         int uel = rowuels[r * nkeys + k];
+         auto it = uelcode.find(uel);
+         if( it == uelcode.end() )
+         {
+            it = uelcode.insert(std::make_pair(uel, (uint32_t)uels.size())).first;
+            uels.push_back(uel);
+         }
+         codes[r] = it->second;
+      }
+      write(codes.data(), nrows * sizeof(uint32_t));
+      align();
+   }
+
+   std::vector<double> column(nrows);
+   for( size_t v = 0; v < nvalues; ++v )
+   {
+      for( size_t r = 0; r < nrows; ++r )
+         column[r] = vals[r * nvalues + v];
+      write(column.data(), nrows * sizeof(double));
+   }
+
+   toc.push_back(entry);
+   return (uint32_t)(toc.size() - 1);
+}
+
+bool MosdexBinaryWriter::close(
+   const std::function<std::string(int)>& label
+)
+{
+   assert(fp != NULL);
+
+   MosdexBinHeader header;
+   memcpy(header.magic, MOSDEXBIN_MAGIC, sizeof(header.magic));
+   header.version = MOSDEXBIN_VERSION;
+   header.ntables = (uint32_t)toc.size();
+   header.nuels = uels.size();
+
+   // UEL string table
+   std::vector<std::string> labels;
+   std::vector<uint64_t> offsets;
+   uint64_t labeloffset = 0;
+   for( int uel : uels )
+   {
+      labels.push_back(label(uel));
+      offsets.push_back(labeloffset);
+      labeloffset += labels.back().size() + 1;
+   }
+
+   align();
+   header.uelsoffset = offset;
+   write(offsets.data(), offsets.size() * sizeof(uint64_t));
+   for( auto& l : labels )
+      write(l.c_str(), l.size() + 1);
+
+   align();
+   header.tocoffset = offset;
+   write(toc.data(), toc.size() * sizeof(MosdexBinTocEntry));
+
+   if( fseek(fp, 0, SEEK_SET) != 0 )
+      failed = true;
+   else if( fwrite(&header, 1, sizeof(header), fp) != sizeof(header) )
+      failed = true;
+
+   if( fclose(fp) != 0 )
+      failed = true;
+   fp = NULL;
+
+   if( failed )
+      std::cerr << "Error writing binary DATA file" << std::endl;
+
+   return !failed;
+}
+
+MosdexBinaryReader::MosdexBinaryReader()
+: data(NULL), size(0), header(NULL), ueloffsets(NULL), labels(NULL), toc(NULL)
+{ }
+
+MosdexBinaryReader::~MosdexBinaryReader()
+{
+   close();
+}
+
+bool MosdexBinaryReader::open(
+   const char* filename
+)
+{
+   assert(data == NULL);
+
+   if( !isLittleEndian() )
+   {
+      std::cerr << "Binary DATA files can only be read on little-endian hosts" << std::endl;
+      return false;
+   }
+
+   int fd = ::open(filename, O_RDONLY);
+   if( fd < 0 )
+   {
+      std::cerr << "File " << filename << " not found" << std::endl;
+      return false;
+   }
+
+   struct stat st;
+   if( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MosdexBinHeader) )
+   {
+      std::cerr << "File " << filename << " is not a binary DATA file" << std::endl;
+      ::close(fd);
+      return false;
+   }
+   size = (size_t)st.st_size;
+
+   void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+   if( addr == MAP_FAILED )
+   {
+      std::cerr << "Could not map " << filename << " into memory" << std::endl;
+      return false;
+   }
+   data = (const char*)addr;
+
+   header = (const MosdexBinHeader*)data;
+   bool valid = memcmp(header->magic, MOSDEXBIN_MAGIC, sizeof(header->magic)) == 0 && header->version == MOSDEXBIN_VERSION;
+   valid = valid && header->uelsoffset % 8 == 0 && header->uelsoffset + header->nuels * sizeof(uint64_t) <= size;
+   valid = valid && header->tocoffset % 8 == 0 && header->tocoffset + header->ntables * sizeof(MosdexBinTocEntry) <= size;
+   if( valid )
+   {
+      ueloffsets = (const uint64_t*)(data + header->uelsoffset);
+      labels = (const char*)(ueloffsets + header->nuels);
+      toc = (const MosdexBinTocEntry*)(data + header->tocoffset);
+
+      for( uint32_t t = 0; t < header->ntables && valid; ++t )
+      {
+         uint64_t tablesize = ((toc[t].nrows + 1) & ~(uint64_t)1) * sizeof(uint32_t) * toc[t].nkeys + toc[t].nrows * sizeof(double) * toc[t].nvalues;
+         valid = toc[t].offset % 8 == 0 && toc[t].offset + tablesize <= header->uelsoffset;
+      }
+      for( uint64_t u = 0; u < header->nuels && valid; ++u )
+         valid = labels + ueloffsets[u] < data + header->tocoffset;
+   }
+
+   if( !valid )
+   {
+      std::cerr << "File " << filename << " is not a valid binary DATA file" << std::endl;
+      close();
+      return false;
+   }
+
+   return true;
+}
+
+void MosdexBinaryReader::close()
+{
+   if( data != NULL )
+      munmap((void*)data, size);
+   data = NULL;
+   size = 0;
+}
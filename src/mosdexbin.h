@@ -0,0 +1,160 @@
+#ifndef MOSDEXBIN_H
+#define MOSDEXBIN_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+// binary companion file for the DATA section of a MOSDEX file
+//
+// all numbers are little-endian, all sections start at 8-byte aligned offsets
+//
+//   header    char magic[8] = "MOSDEXB1", uint32 version, uint32 ntables,
+//             uint64 nuels, uint64 uelsoffset, uint64 tocoffset
+//   tables    for each table: nkeys columns of uint32 UEL codes, then nvalues columns of float64,
+//             each column holding nrows entries; a value that is not given is NaN
+//   uels      uint64 offsets[nuels], then the labels, each terminated by '\0';
+//             offsets are relative to the first label
+//   toc       for each table: uint64 nrows, uint32 nkeys, uint32 nvalues, uint64 offset
+//
+// the JSON document refers to a table by its position in the toc, names of tables and columns are kept there
+
+#define MOSDEXBIN_MAGIC   "MOSDEXB1"
+#define MOSDEXBIN_VERSION 1
+
+struct MosdexBinHeader
+{
+   char     magic[8];
+   uint32_t version;
+   uint32_t ntables;
+   uint64_t nuels;
+   uint64_t uelsoffset;
+   uint64_t tocoffset;
+};
+
+struct MosdexBinTocEntry
+{
+   uint64_t nrows;
+   uint32_t nkeys;
+   uint32_t nvalues;
+   uint64_t offset;
+};
+
+class MosdexBinaryWriter
+{
+public:
+   MosdexBinaryWriter();
+   ~MosdexBinaryWriter();
+
+   bool open(
+      const char* filename
+   );
+
+   // writes a table given row after row, with keys as (caller) UEL indices and NaN for values not given
+   // returns position of table in toc
+   uint32_t writeTable(
+      size_t        nrows,
+      size_t        nkeys,
+      const int*    uels,
+      size_t        nvalues,
+      const double* vals
+   );
+
+   // writes UEL labels, toc, and header, and closes the file
+   // label gives the label of a UEL index used in writeTable
+   bool close(
+      const std::function<std::string(int)>& label
+   );
+
+private:
+   void write(
+      const void* data,
+      size_t      size
+   );
+   void align();
+
+   FILE* fp;
+   uint64_t offset;
+   bool failed;
+
+   // code for each UEL index, codes in order of first use, UEL index for each code
+   std::map<int, uint32_t> uelcode;
+   std::vector<int> uels;
+
+   std::vector<MosdexBinTocEntry> toc;
+};
+
+class MosdexBinaryReader
+{
+public:
+   MosdexBinaryReader();
+   ~MosdexBinaryReader();
+
+   // maps file into memory and checks its header and toc
+   bool open(
+      const char* filename
+   );
+
+   void close();
+
+   bool isOpen() const
+   {
+      return data != NULL;
+   }
+
+   uint32_t ntables() const
+   {
+      return header->ntables;
+   }
+
+   uint64_t nuels() const
+   {
+      return header->nuels;
+   }
+
+   const MosdexBinTocEntry& table(
+      uint32_t t
+   ) const
+   {
+      return toc[t];
+   }
+
+   // column of UEL codes of a table
+   const uint32_t* keyColumn(
+      uint32_t t,
+      uint32_t k
+   ) const
+   {
+      return (const uint32_t*)(data + toc[t].offset) + ((toc[t].nrows + 1) & ~(uint64_t)1) * k;
+   }
+
+   // column of values of a table, NaN if value is not given for a row
+   const double* valueColumn(
+      uint32_t t,
+      uint32_t v
+   ) const
+   {
+      return (const double*)(keyColumn(t, toc[t].nkeys)) + toc[t].nrows * v;
+   }
+
+   const char* uelLabel(
+      uint32_t code
+   ) const
+   {
+      return labels + ueloffsets[code];
+   }
+
+private:
+   const char* data;
+   size_t size;
+
+   const MosdexBinHeader* header;
+   const uint64_t* ueloffsets;
+   const char* labels;
+   const MosdexBinTocEntry* toc;
+};
+
+#endif
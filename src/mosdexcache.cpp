@@ -0,0 +1,374 @@
+#include <cstring>
+#include <cctype>
+#include <ctime>
+#include <cerrno>
+#include <iostream>
+#include <set>
+#include <algorithm>
+
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "mosdexcache.h"
+
+// temporary files left behind by processes that died are removed after this many seconds
+#define STALETEMPAGE 3600
+
+// reads a whole file, returns false if it cannot be read
+static
+bool readFile(
+   const std::string& filename,
+   std::string&       content
+)
+{
+   FILE* fp = fopen(filename.c_str(), "rb");
+   if( fp == NULL )
+      return false;
+
+   char buf[1 << 16];
+   size_t n;
+   content.clear();
+   while( (n = fread(buf, 1, sizeof(buf), fp)) > 0 )
+      content.append(buf, n);
+
+   bool ok = !ferror(fp);
+   fclose(fp);
+   return ok;
+}
+
+static
+bool copyFile(
+   FILE*       src,
+   const char* dstname
+)
+{
+   FILE* dst = fopen(dstname, "wb");
+   if( dst == NULL )
+      return false;
+
+   char buf[1 << 16];
+   size_t n;
+   bool ok = true;
+   while( ok && (n = fread(buf, 1, sizeof(buf), src)) > 0 )
+      ok = fwrite(buf, 1, n, dst) == n;
+   ok = ok && !ferror(src);
+
+   if( fclose(dst) != 0 )
+      ok = false;
+   return ok;
+}
+
+static
+bool fileExists(
+   const std::string& filename
+)
+{
+   struct stat st;
+   return stat(filename.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static
+std::string dirName(
+   const std::string& filename
+)
+{
+   size_t slash = filename.find_last_of('/');
+   return slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+}
+
+// whether a filename of a dollar control option has an extension
+static
+bool hasExtension(
+   const std::string& filename
+)
+{
+   size_t dot = filename.find_last_of('.');
+   return dot != std::string::npos && filename.find('/', dot) == std::string::npos;
+}
+
+// adds a file that a model reads at compile time to the hash, and the files that it includes in turn
+// a file that is not found is hashed by its name, as it may be included conditionally
+static
+bool addModelFile(
+   WideHash&              h,
+   const std::string&     filename,
+   std::set<std::string>& seen
+)
+{
+   h.add(filename);
+   if( !seen.insert(filename).second )
+      return true;
+
+   std::string content;
+   if( !readFile(filename, content) )
+   {
+      h.add("missing");
+      return true;
+   }
+   h.add(content);
+
+   // GAMS files are hashed as a whole, other files (e.g., gdx) only need their content
+   if( filename.size() >= 4 && strcasecmp(filename.c_str() + filename.size() - 4, ".gdx") == 0 )
+      return true;
+
+   // dollar control options on each line, e.g. "$include file" or "$if exist file $include file"
+   size_t pos = 0;
+   while( (pos = content.find('$', pos)) != std::string::npos )
+   {
+      size_t start = ++pos;
+      while( pos < content.size() && (isalnum(content[pos]) || content[pos] == '_') )
+         ++pos;
+      std::string option = content.substr(start, pos - start);
+      std::transform(option.begin(), option.end(), option.begin(), ::tolower);
+
+      // programs run at compile time may read or write anything
+      if( option == "call" || option == "hiddencall" || option == "calltool" || option == "embeddedcode" || option == "onembeddedcode"
+         || option == "libinclude" || option == "sysinclude" || option == "funclibin" )
+      {
+         std::cerr << "Model " << filename << " uses $" << option << ", cannot cache its conversion" << std::endl;
+         return false;
+      }
+
+      const char* extension;
+      if( option == "include" || option == "batinclude" )
+         extension = ".gms";
+      else if( option == "gdxin" )
+         extension = ".gdx";
+      else
+         continue;
+
+      // argument up to end of line or next blank, possibly quoted
+      while( pos < content.size() && (content[pos] == ' ' || content[pos] == '\t') )
+         ++pos;
+      std::string arg;
+      if( pos < content.size() && (content[pos] == '"' || content[pos] == '\'') )
+      {
+         size_t end = content.find(content[pos], pos + 1);
+         if( end == std::string::npos )
+            end = content.size();
+         arg = content.substr(pos + 1, end - pos - 1);
+      }
+      else
+      {
+         size_t end = pos;
+         while( end < content.size() && !isspace(content[end]) )
+            ++end;
+         arg = content.substr(pos, end - pos);
+      }
+
+      // "$gdxin" without a file closes the gdx file
+      if( arg.empty() )
+         continue;
+
+      if( arg.find('%') != std::string::npos )
+      {
+         std::cerr << "Model " << filename << " includes " << arg << " by a compile-time variable, cannot cache its conversion" << std::endl;
+         return false;
+      }
+
+      if( !hasExtension(arg) )
+         arg += extension;
+
+      // relative to the including file, else to the working directory, as GAMS would search
+      std::string included = arg;
+      if( arg[0] != '/' && fileExists(dirName(filename) + arg) )
+         included = dirName(filename) + arg;
+
+      if( !addModelFile(h, included, seen) )
+         return false;
+   }
+
+   return true;
+}
+
+bool MosdexCache::open(
+   const char* dir_,
+   uint64_t    maxsize_
+)
+{
+   dir = dir_;
+   if( !dir.empty() && dir.back() != '/' )
+      dir += '/';
+   maxsize = maxsize_;
+
+   if( mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST )
+   {
+      std::cerr << "Could not create cache directory " << dir << std::endl;
+      return false;
+   }
+
+   return true;
+}
+
+bool MosdexCache::setKey(
+   const std::string&              options,
+   const char*                     gmsfile,
+   const std::vector<std::string>& otherfiles
+)
+{
+   WideHash h;
+   std::set<std::string> seen;
+
+   h.add(options);
+   if( !addModelFile(h, gmsfile, seen) )
+      return false;
+
+   keytext = options + "\n";
+   for( auto& f : seen )
+      keytext += f + "\n";
+
+   for( auto& f : otherfiles )
+   {
+      std::string content;
+      if( !readFile(f, content) )
+         return false;
+      h.add(f);
+      h.add(content);
+      keytext += f + "\n";
+   }
+
+   key = h.hex();
+   return true;
+}
+
+bool MosdexCache::fetch(
+   const char*                     outfile,
+   const std::vector<std::string>& suffixes
+)
+{
+   // an entry of other inputs that happen to have the same key is not taken
+   std::string entrykeytext;
+   if( !readFile(dir + key + ".key", entrykeytext) || entrykeytext != keytext )
+      return false;
+
+   // open all files of the entry first; an entry that is evicted meanwhile stays readable
+   std::vector<FILE*> srcs;
+   for( auto& suffix : suffixes )
+   {
+      FILE* fp = fopen((dir + key + suffix).c_str(), "rb");
+      if( fp == NULL )
+         break;
+      srcs.push_back(fp);
+   }
+
+   bool ok = srcs.size() == suffixes.size();
+   for( size_t i = 0; i < srcs.size() && ok; ++i )
+      ok = copyFile(srcs[i], (std::string(outfile) + suffixes[i]).c_str());
+
+   for( FILE* fp : srcs )
+      fclose(fp);
+
+   // recently used entries are evicted last
+   if( ok )
+      for( auto& suffix : suffixes )
+         utime((dir + key + suffix).c_str(), NULL);
+
+   return ok;
+}
+
+bool MosdexCache::store(
+   const char*                     outfile,
+   const std::vector<std::string>& suffixes
+)
+{
+   char pid[32];
+   snprintf(pid, sizeof(pid), ".tmp.%ld", (long)getpid());
+
+   // the key text first, so that it is there once the entry is
+   std::string keyfile = dir + key + ".key";
+   std::string keytmp = keyfile + pid;
+   FILE* fp = fopen(keytmp.c_str(), "wb");
+   bool ok = fp != NULL;
+   if( ok )
+   {
+      ok = fwrite(keytext.data(), 1, keytext.size(), fp) == keytext.size();
+      ok = fclose(fp) == 0 && ok;
+      ok = ok && rename(keytmp.c_str(), keyfile.c_str()) == 0;
+      if( !ok )
+         remove(keytmp.c_str());
+   }
+
+   // main file last, so that an entry is complete once it exists
+   for( size_t i = suffixes.size(); i > 0 && ok; --i )
+   {
+      const std::string& suffix = suffixes[i-1];
+      std::string entry = dir + key + suffix;
+      std::string tmp = entry + pid;
+
+      FILE* src = fopen((std::string(outfile) + suffix).c_str(), "rb");
+      if( src == NULL )
+      {
+         ok = false;
+         break;
+      }
+      ok = copyFile(src, tmp.c_str()) && rename(tmp.c_str(), entry.c_str()) == 0;
+      fclose(src);
+
+      if( !ok )
+         remove(tmp.c_str());
+   }
+
+   if( !ok )
+      std::cerr << "Could not add " << outfile << " to cache " << dir << std::endl;
+
+   evict();
+
+   return ok;
+}
+
+void MosdexCache::evict()
+{
+   DIR* dp = opendir(dir.c_str());
+   if( dp == NULL )
+      return;
+
+   // entries are the files whose name starts with a key
+   std::vector<std::pair<time_t, std::string> > entries;
+   uint64_t total = 0;
+   time_t now = time(NULL);
+
+   struct dirent* de;
+   while( (de = readdir(dp)) != NULL )
+   {
+      const char* name = de->d_name;
+      if( strlen(name) < 32 || strspn(name, "0123456789abcdef") < 32 )
+         continue;
+
+      struct stat st;
+      std::string path = dir + name;
+      if( stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) )
+         continue;
+
+      if( strstr(name, ".tmp.") != NULL )
+      {
+         if( now - st.st_mtime > STALETEMPAGE )
+            remove(path.c_str());
+         continue;
+      }
+
+      entries.push_back(std::make_pair(st.st_mtime, path));
+      total += (uint64_t)st.st_size;
+   }
+   closedir(dp);
+
+   if( total <= maxsize )
+      return;
+
+   // least recently used first; another process may have removed a file already
+   std::sort(entries.begin(), entries.end());
+   for( auto& e : entries )
+   {
+      if( total <= maxsize )
+         break;
+
+      struct stat st;
+      if( stat(e.second.c_str(), &st) != 0 )
+         continue;
+      if( remove(e.second.c_str()) == 0 )
+         total -= std::min(total, (uint64_t)st.st_size);
+   }
+}
@@ -0,0 +1,129 @@
+#ifndef MOSDEXCACHE_H
+#define MOSDEXCACHE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 64-bit FNV-1a, fed piecewise
+class ContentHash
+{
+public:
+   uint64_t h = 14695981039346656037ULL;
+
+   void add(
+      const void* data,
+      size_t      size
+      )
+   {
+      for( size_t i = 0; i < size; ++i )
+      {
+         h ^= ((const unsigned char*)data)[i];
+         h *= 1099511628211ULL;
+      }
+   }
+
+   // adds a string including its terminating '\0', so that concatenations are distinguished
+   void add(
+      const std::string& str
+      )
+   {
+      add(str.c_str(), str.size() + 1);
+   }
+
+   std::string hex() const
+   {
+      char buf[17];
+      snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+      return buf;
+   }
+};
+
+// 128-bit FNV-1a, fed piecewise, for cache keys, which have to tell apart all conversions ever stored
+class WideHash
+{
+public:
+   unsigned __int128 h = ((unsigned __int128)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+
+   void add(
+      const void* data,
+      size_t      size
+      )
+   {
+      static const unsigned __int128 prime = ((unsigned __int128)1 << 88) | 0x13b;
+      for( size_t i = 0; i < size; ++i )
+      {
+         h ^= ((const unsigned char*)data)[i];
+         h *= prime;
+      }
+   }
+
+   // adds a string including its terminating '\0', so that concatenations are distinguished
+   void add(
+      const std::string& str
+      )
+   {
+      add(str.c_str(), str.size() + 1);
+   }
+
+   std::string hex() const
+   {
+      char buf[33];
+      snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)(h >> 64), (unsigned long long)h);
+      return buf;
+   }
+};
+
+// directory of previous conversion results, keyed by a hash of the model files and the converter options
+//
+// an entry <key><suffix> is written to a temporary file and renamed into place, so other processes
+// see either no entry or a complete one; entries are evicted least recently used first
+// next to each entry, <key>.key holds the options and the names of the files that the key was computed from,
+// which fetch compares, so that an entry is only taken for the same inputs
+class MosdexCache
+{
+public:
+   // maxsize is the size in bytes that the entries may take up after store()
+   bool open(
+      const char* dir,
+      uint64_t    maxsize
+   );
+
+   // computes the key from the converter options, the model file and the files it includes, and the other files
+   // (e.g., of the GAMS system) by their content
+   // returns false if the inputs of the model cannot be determined, e.g., because it runs programs at compile time
+   bool setKey(
+      const std::string&              options,
+      const char*                     gmsfile,
+      const std::vector<std::string>& otherfiles
+   );
+
+   const std::string& getKey() const
+   {
+      return key;
+   }
+
+   // copies the entry to outfile, for each of the suffixes (e.g., "" and ".idx")
+   // returns false if there is no complete entry
+   bool fetch(
+      const char*                     outfile,
+      const std::vector<std::string>& suffixes
+   );
+
+   // adds outfile as entry, for each of the suffixes, then evicts entries over the size limit
+   bool store(
+      const char*                     outfile,
+      const std::vector<std::string>& suffixes
+   );
+
+private:
+   void evict();
+
+   std::string dir;
+   uint64_t maxsize = 0;
+   std::string key;
+   std::string keytext;
+};
+
+#endif
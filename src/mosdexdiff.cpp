@@ -0,0 +1,542 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "mosdexio.h"
+#include "mosdexread.h"
+#include "mosdexcache.h"
+
+using namespace rapidjson;
+
+// compares the models of two MOSDEX documents, e.g., an export and the export of its round trip through mosdex2gams:
+// variables, constraints, objectives, and coefficient blocks are summarized by a hash of their entries that does not
+// depend on the order of the entries or on the layout of the DATA tables, and differing entries are listed for those
+// whose summaries differ
+
+// a variable, constraint, objective, or coefficient block
+class Item
+{
+public:
+   // names the item in both documents, e.g. "variable x" or "coefficients e x"
+   std::string key;
+
+   // 'V'ariable, 'C'onstraint, 'O'bjective, or coefficient bloc'K'
+   char kind;
+
+   // the symbol, or the coefficient block with its constraint and variable
+   const Value* sym = NULL;
+   const Value* con = NULL;
+   const Value* var = NULL;
+};
+
+// number of entries of an item and the sum of their hashes
+class Summary
+{
+public:
+   uint64_t nentries = 0;
+   uint64_t hash = 0;
+
+   bool operator!=(
+      const Summary& other
+      ) const
+   {
+      return nentries != other.nentries || hash != other.hash;
+   }
+};
+
+// callback for the entries of an item: labels (for coefficients, of the constraint entry, then of the variable entry)
+// and canonical values
+typedef std::function<void(const std::vector<const char*>&, const double*, size_t)> CanonicalCallback;
+
+// -0.0 and 0.0 are the same value
+static
+double canonical(
+   double val
+   )
+{
+   return val == 0.0 ? 0.0 : val;
+}
+
+// calls f for each entry of an item with its canonical values:
+// type, lower and upper bound of variable entries; lower and upper bound of constraint entries, whether given by RHS
+// and SENSE or by BOUNDS; 1 for minimization and -1 for maximization; nonzero coefficients, whether given by a table
+// or a single value
+static
+void forEachCanonical(
+   Document&                d,
+   const Item&              item,
+   const CanonicalCallback& f
+   )
+{
+   double vals[3];
+   switch( item.kind )
+   {
+      case 'V':
+         forEachVariableEntry(d, *item.sym, [&](const std::vector<const char*>& labels, char type, double lb, double ub)
+            {
+               vals[0] = type;
+               vals[1] = canonical(lb);
+               vals[2] = canonical(ub);
+               f(labels, vals, 3);
+            });
+         break;
+
+      case 'C':
+         forEachConstraintEntry(d, *item.sym, [&](const std::vector<const char*>& labels, double lb, double ub)
+            {
+               vals[0] = canonical(lb);
+               vals[1] = canonical(ub);
+               f(labels, vals, 2);
+            });
+         break;
+
+      case 'O':
+         vals[0] = (*item.sym)["SENSE"] == "maximize" ? -1.0 : 1.0;
+         f(std::vector<const char*>(), vals, 1);
+         break;
+
+      case 'K':
+      {
+         std::vector<const char*> labels;
+         forEachCoefficient(d, *item.sym, *item.con, *item.var,
+            [&](const std::vector<const char*>& conlabels, const std::vector<const char*>& varlabels, double val)
+            {
+               if( val == 0.0 )
+                  return;
+               labels.assign(conlabels.begin(), conlabels.end());
+               labels.insert(labels.end(), varlabels.begin(), varlabels.end());
+               vals[0] = val;
+               f(labels, vals, 1);
+            });
+         break;
+      }
+   }
+}
+
+// hash of an entry, mixed so that sums of hashes of different entries do not cancel out
+static
+uint64_t entryHash(
+   const std::vector<const char*>& labels,
+   const double*                   vals,
+   size_t                          nvals
+   )
+{
+   ContentHash h;
+   for( const char* label : labels )
+      h.add(label, strlen(label) + 1);
+   h.add(vals, nvals * sizeof(double));
+
+   uint64_t x = h.h;
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdULL;
+   x ^= x >> 33;
+   x *= 0xc4ceb9fe1a85ec53ULL;
+   x ^= x >> 33;
+   return x;
+}
+
+static
+std::vector<Item> collectItems(
+   Document& d
+   )
+{
+   std::vector<Item> items;
+   std::map<std::string, const Value*> symbols;
+
+   const char* sections[] = { "VARIABLES", "CONSTRAINTS", "DECISION_EXPRESSIONS" };
+   const char* prefixes[] = { "variable ", "constraint ", "objective " };
+   const char kinds[] = { 'V', 'C', 'O' };
+   for( int s = 0; s < 3; ++s )
+   {
+      if( !d.HasMember(sections[s]) )
+         continue;
+
+      auto& syms = d[sections[s]];
+      for( Value::ConstValueIterator itr = syms.Begin(); itr != syms.End(); ++itr )
+      {
+         symbols[(*itr)["NAME"].GetString()] = &*itr;
+         if( kinds[s] == 'O' && !itr->HasMember("SENSE") )
+            continue;
+
+         Item item;
+         item.key = prefixes[s] + std::string((*itr)["NAME"].GetString());
+         item.kind = kinds[s];
+         item.sym = &*itr;
+         items.push_back(item);
+      }
+   }
+
+   auto& coefs = d["COEFFICIENTS"];
+   for( Value::ConstValueIterator itr = coefs.Begin(); itr != coefs.End(); ++itr )
+   {
+      if( !itr->HasMember("CONSTRAINTS") )
+         continue;
+
+      Item item;
+      item.key = std::string("coefficients ") + (*itr)["CONSTRAINTS"].GetString() + " " + (*itr)["VARIABLES"].GetString();
+      item.kind = 'K';
+      item.sym = &*itr;
+      item.con = symbols.at((*itr)["CONSTRAINTS"].GetString());
+      item.var = symbols.at((*itr)["VARIABLES"].GetString());
+      items.push_back(item);
+   }
+
+   return items;
+}
+
+// loads a document, after unloading the one before, as the reader keeps the state of the document it loaded
+static
+bool load(
+   std::unique_ptr<Document>& d,
+   const char*                file,
+   unsigned                   nthreads
+   )
+{
+   if( d )
+   {
+      unloadMosdex();
+      d.reset();
+   }
+   d.reset(new Document);
+   return loadMosdex(*d, file, compressionFromFilename(file), nthreads);
+}
+
+// calls f(i) for each item i, on up to nthreads threads, one item at a time
+static
+void forEachItem(
+   Document&                         d,
+   const std::vector<Item>&          items,
+   unsigned                          nthreads,
+   const std::function<void(size_t)>& f
+   )
+{
+   // schemas are resolved up front, so the threads only look them up
+   auto& inputdata = d["INPUT_DATA_MODEL"];
+   for( Value::ConstMemberIterator itr = inputdata.MemberBegin(); itr != inputdata.MemberEnd(); ++itr )
+      getSchema(d, itr->name.GetString());
+
+   std::atomic<size_t> next(0);
+   auto worker = [&]()
+   {
+      for( size_t i = next++; i < items.size(); i = next++ )
+         f(i);
+   };
+
+   std::vector<std::thread> threads;
+   for( unsigned t = 1; t < nthreads && t < items.size(); ++t )
+      threads.push_back(std::thread(worker));
+   worker();
+   for( auto& t : threads )
+      t.join();
+}
+
+// summaries of all items, by key
+// items with the same key, e.g., two blocks of the same constraint and variable, are summarized together
+static
+std::map<std::string, Summary> summarize(
+   Document&                d,
+   const std::vector<Item>& items,
+   unsigned                 nthreads
+   )
+{
+   std::vector<Summary> summaries(items.size());
+   forEachItem(d, items, nthreads, [&](size_t i)
+      {
+         Summary& s = summaries[i];
+         forEachCanonical(d, items[i], [&](const std::vector<const char*>& labels, const double* vals, size_t nvals)
+            {
+               ++s.nentries;
+               s.hash += entryHash(labels, vals, nvals);
+            });
+      });
+
+   std::map<std::string, Summary> bykey;
+   for( size_t i = 0; i < items.size(); ++i )
+   {
+      Summary& s = bykey[items[i].key];
+      s.nentries += summaries[i].nentries;
+      s.hash += summaries[i].hash;
+   }
+   return bykey;
+}
+
+// bucket of an entry among nbuckets (a power of 2), by its labels only,
+// so that an entry has the same bucket in both documents, whatever its values
+static
+size_t bucketOf(
+   const std::vector<const char*>& labels,
+   size_t                          nbuckets
+   )
+{
+   return entryHash(labels, NULL, 0) & (nbuckets - 1);
+}
+
+// summaries of the entries of the items with the given keys, by bucket, see bucketOf
+static
+std::map<std::string, std::vector<Summary> > summarizeBuckets(
+   Document&                            d,
+   const std::vector<Item>&             items,
+   const std::map<std::string, size_t>& nbuckets,
+   unsigned                             nthreads
+   )
+{
+   std::vector<std::vector<Summary> > summaries(items.size());
+   forEachItem(d, items, nthreads, [&](size_t i)
+      {
+         auto it = nbuckets.find(items[i].key);
+         if( it == nbuckets.end() )
+            return;
+
+         std::vector<Summary>& buckets = summaries[i];
+         buckets.resize(it->second);
+         forEachCanonical(d, items[i], [&](const std::vector<const char*>& labels, const double* vals, size_t nvals)
+            {
+               Summary& s = buckets[bucketOf(labels, buckets.size())];
+               ++s.nentries;
+               s.hash += entryHash(labels, vals, nvals);
+            });
+      });
+
+   std::map<std::string, std::vector<Summary> > bykey;
+   for( size_t i = 0; i < items.size(); ++i )
+   {
+      if( summaries[i].empty() )
+         continue;
+
+      std::vector<Summary>& buckets = bykey[items[i].key];
+      buckets.resize(summaries[i].size());
+      for( size_t b = 0; b < buckets.size(); ++b )
+      {
+         buckets[b].nentries += summaries[i][b].nentries;
+         buckets[b].hash += summaries[i][b].hash;
+      }
+   }
+   return bykey;
+}
+
+static
+std::string num(
+   double val
+   )
+{
+   char buf[32];
+   snprintf(buf, sizeof(buf), "%.17g", val);
+   return buf;
+}
+
+// entries in the given buckets of the items, by item key, as descriptions of their labels and of their values
+static
+void collectEntries(
+   Document&                                                      d,
+   const std::vector<Item>&                                       items,
+   const std::map<std::string, size_t>&                           nbuckets,
+   const std::map<std::string, std::set<size_t> >&                selected,
+   std::map<std::string, std::map<std::string, std::string> >&    entries
+   )
+{
+   for( auto& item : items )
+   {
+      auto sit = selected.find(item.key);
+      if( sit == selected.end() )
+         continue;
+
+      const std::set<size_t>& buckets = sit->second;
+      size_t nitembuckets = nbuckets.at(item.key);
+      std::map<std::string, std::string>& itementries = entries[item.key];
+      size_t ncon = item.kind == 'K' ? symbolKeys(d, *item.con).size() : 0;
+
+      forEachCanonical(d, item, [&](const std::vector<const char*>& labels, const double* vals, size_t nvals)
+         {
+            if( buckets.count(bucketOf(labels, nitembuckets)) == 0 )
+               return;
+
+            std::string key = "(";
+            for( size_t i = 0; i < labels.size(); ++i )
+            {
+               if( i > 0 )
+                  key += i == ncon ? ") (" : ",";
+               key += labels[i];
+            }
+            key += ")";
+
+            std::string desc;
+            if( item.kind == 'V' )
+               desc = std::string(1, (char)vals[0]) + " [" + num(vals[1]) + ", " + num(vals[2]) + "]";
+            else if( item.kind == 'C' )
+               desc = "[" + num(vals[0]) + ", " + num(vals[1]) + "]";
+            else if( item.kind == 'O' )
+               desc = vals[0] < 0.0 ? "maximize" : "minimize";
+            else
+               desc = num(vals[0]);
+
+            itementries[key] = desc;
+         });
+   }
+}
+
+int main(
+   int    argc,
+   char** argv
+)
+{
+   unsigned nthreads = std::max(std::thread::hardware_concurrency(), 1u);
+   size_t maxdiff = 10;
+
+   int argi = 1;
+   for( ; argi < argc - 2 && argv[argi][0] == '-'; ++argi )
+   {
+      if( strcmp(argv[argi], "-threads") == 0 && argi + 1 < argc - 2 )
+         nthreads = std::max(atoi(argv[++argi]), 1);
+      else if( strcmp(argv[argi], "-maxdiff") == 0 && argi + 1 < argc - 2 )
+         maxdiff = strtoull(argv[++argi], NULL, 10);
+      else
+         break;
+   }
+
+   if( argi != argc - 2 )
+   {
+      std::cerr << "Usage: " << argv[0] << " [options] <a.mosdex> <b.mosdex>" << std::endl;
+      std::cerr << "Options:" << std::endl;
+      std::cerr << "  -threads <n>   number of threads for reading and summarizing (default: all cores)" << std::endl;
+      std::cerr << "  -maxdiff <n>   list at most n differing entries of each variable, constraint, or block (default: 10)" << std::endl;
+      std::cerr << "Exits with 0 if the models are the same, 1 if they differ, 2 on error." << std::endl;
+      return 2;
+   }
+   const char* files[2] = { argv[argi], argv[argi+1] };
+
+   std::map<std::string, Summary> summaries[2];
+   std::vector<Item> items;
+   std::unique_ptr<Document> d;
+   for( int f = 0; f < 2; ++f )
+   {
+      if( !load(d, files[f], nthreads) )
+         return 2;
+      items = collectItems(*d);
+      summaries[f] = summarize(*d, items, nthreads);
+   }
+
+   // items in only one document, and items in both that differ
+   bool same = true;
+   std::set<std::string> differing;
+   for( int f = 0; f < 2; ++f )
+      for( auto& s : summaries[f] )
+         if( summaries[1-f].count(s.first) == 0 )
+         {
+            std::cout << s.first << ": only in " << files[f] << std::endl;
+            same = false;
+         }
+   for( auto& s : summaries[0] )
+   {
+      auto it = summaries[1].find(s.first);
+      if( it != summaries[1].end() && it->second != s.second )
+         differing.insert(s.first);
+   }
+
+   if( differing.empty() )
+   {
+      if( same )
+         std::cout << "Models are the same: " << summaries[0].size() << " variables, constraints, objectives, and coefficient blocks" << std::endl;
+      return same ? EXIT_SUCCESS : 1;
+   }
+
+   // the entries of a differing item are split into buckets of about 16 entries by their labels, and only those of
+   // the first maxdiff buckets that differ are collected, so that listing differences does not grow with the item
+   std::map<std::string, size_t> nbuckets;
+   for( auto& key : differing )
+   {
+      uint64_t n = std::max(summaries[0][key].nentries, summaries[1][key].nentries) / 16;
+      size_t nb = 1;
+      while( nb < n && nb < ((size_t)1 << 20) )
+         nb <<= 1;
+      nbuckets[key] = nb;
+   }
+
+   // of the second document, which is still loaded, then of the first
+   std::map<std::string, std::vector<Summary> > buckets[2];
+   buckets[1] = summarizeBuckets(*d, items, nbuckets, nthreads);
+   if( !load(d, files[0], nthreads) )
+      return 2;
+   items = collectItems(*d);
+   buckets[0] = summarizeBuckets(*d, items, nbuckets, nthreads);
+
+   // each differing bucket has at least one differing entry
+   std::map<std::string, std::set<size_t> > selected;
+   std::map<std::string, size_t> nunlisted;
+   for( auto& key : differing )
+   {
+      std::set<size_t>& sel = selected[key];
+      for( size_t b = 0; b < nbuckets[key]; ++b )
+      {
+         if( !(buckets[0][key][b] != buckets[1][key][b]) )
+            continue;
+         if( sel.size() < maxdiff )
+            sel.insert(b);
+         else
+            ++nunlisted[key];
+      }
+   }
+
+   std::map<std::string, std::map<std::string, std::string> > entries[2];
+   collectEntries(*d, items, nbuckets, selected, entries[0]);
+   if( !load(d, files[1], nthreads) )
+      return 2;
+   items = collectItems(*d);
+   collectEntries(*d, items, nbuckets, selected, entries[1]);
+
+   for( auto& key : differing )
+   {
+      const std::map<std::string, std::string>& a = entries[0][key];
+      const std::map<std::string, std::string>& b = entries[1][key];
+      std::cout << key << ": " << summaries[0][key].nentries << " entries in " << files[0] << ", " << summaries[1][key].nentries << " in " << files[1] << std::endl;
+
+      // both are sorted by label description, so they are merged
+      size_t ndiff = 0;
+      auto ia = a.begin();
+      auto ib = b.begin();
+      while( ia != a.end() || ib != b.end() )
+      {
+         std::string line;
+         if( ib == b.end() || (ia != a.end() && ia->first < ib->first) )
+         {
+            line = ia->first + ": " + ia->second + " only in " + files[0];
+            ++ia;
+         }
+         else if( ia == a.end() || ib->first < ia->first )
+         {
+            line = ib->first + ": " + ib->second + " only in " + files[1];
+            ++ib;
+         }
+         else
+         {
+            if( ia->second != ib->second )
+               line = ia->first + ": " + ia->second + " vs " + ib->second;
+            ++ia;
+            ++ib;
+         }
+
+         if( line.empty() )
+            continue;
+         if( ndiff++ < maxdiff )
+            std::cout << "  " << line << std::endl;
+      }
+
+      // the buckets that were not collected are counted by one difference each
+      size_t nmore = (ndiff > maxdiff ? ndiff - maxdiff : 0) + nunlisted[key];
+      if( nmore > 0 )
+         std::cout << "  ... " << (nunlisted[key] > 0 ? "at least " : "") << nmore << " more" << std::endl;
+   }
+
+   return 1;
+}
@@ -0,0 +1,527 @@
+#include <cstring>
+#include <climits>
+#include <iostream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "mosdexio.h"
+
+#define BUFFERSIZE (1 << 20)
+
+static
+bool endsWith(
+   const char* str,
+   const char* suffix
+)
+{
+   size_t len = strlen(str);
+   size_t suffixlen = strlen(suffix);
+   return len >= suffixlen && strcmp(str + len - suffixlen, suffix) == 0;
+}
+
+Compression compressionFromFilename(
+   const char* filename
+)
+{
+   if( filename == NULL )
+      return COMPRESSION_NONE;
+   if( endsWith(filename, ".gz") )
+      return COMPRESSION_GZIP;
+   if( endsWith(filename, ".zst") || endsWith(filename, ".zstd") )
+      return COMPRESSION_ZSTD;
+   return COMPRESSION_NONE;
+}
+
+bool compressionFromName(
+   const char*  name,
+   Compression* compression
+)
+{
+   if( strcmp(name, "none") == 0 )
+      *compression = COMPRESSION_NONE;
+   else if( strcmp(name, "gzip") == 0 )
+      *compression = COMPRESSION_GZIP;
+   else if( strcmp(name, "zstd") == 0 )
+      *compression = COMPRESSION_ZSTD;
+   else
+      return false;
+   return true;
+}
+
+// reports whether support for a compression has been compiled in
+static
+bool compressionAvailable(
+   Compression compression
+)
+{
+   switch( compression )
+   {
+      case COMPRESSION_NONE :
+         return true;
+      case COMPRESSION_GZIP :
+#ifdef HAVE_ZLIB
+         return true;
+#else
+         std::cerr << "No gzip support: build with zlib (ZLIB=1)" << std::endl;
+         return false;
+#endif
+      case COMPRESSION_ZSTD :
+#ifdef HAVE_ZSTD
+         return true;
+#else
+         std::cerr << "No zstd support: build with libzstd (ZSTD=1)" << std::endl;
+         return false;
+#endif
+   }
+   return false;
+}
+
+MosdexOutputStream::MosdexOutputStream()
+: compression(COMPRESSION_NONE), fp(NULL), gz(NULL), zcs(NULL), pos(0), written(0), failed(false),
+  background(false), pendingsize(0), haspending(false), stopwriter(false)
+{ }
+
+MosdexOutputStream::~MosdexOutputStream()
+{
+   close();
+}
+
+bool MosdexOutputStream::open(
+   const char* filename,
+   Compression compression_
+)
+{
+   assert(fp == NULL && gz == NULL);
+
+   if( !compressionAvailable(compression_) )
+      return false;
+
+   compression = compression_;
+   pos = 0;
+   written = 0;
+   failed = false;
+
+   bool tostdout = filename == NULL || strcmp(filename, "-") == 0;
+
+#ifdef HAVE_ZLIB
+   if( compression == COMPRESSION_GZIP )
+   {
+      gz = tostdout ? gzdopen(fileno(stdout), "wb") : gzopen(filename, "wb");
+      if( gz == NULL )
+      {
+         std::cerr << "Could not open " << (tostdout ? "stdout" : filename) << " for writing" << std::endl;
+         return false;
+      }
+      gzbuffer((gzFile)gz, BUFFERSIZE);
+      buffer.resize(BUFFERSIZE);
+      return true;
+   }
+#endif
+
+   fp = tostdout ? stdout : fopen(filename, "wb");
+   if( fp == NULL )
+   {
+      std::cerr << "Could not open " << filename << " for writing" << std::endl;
+      return false;
+   }
+
+#ifdef HAVE_ZSTD
+   if( compression == COMPRESSION_ZSTD )
+   {
+      zcs = ZSTD_createCStream();
+      ZSTD_initCStream((ZSTD_CStream*)zcs, 3);
+      zbuffer.resize(ZSTD_CStreamOutSize());
+   }
+#endif
+
+   buffer.resize(BUFFERSIZE);
+   return true;
+}
+
+void MosdexOutputStream::startBackgroundWriter()
+{
+   assert(!background);
+
+   background = true;
+   haspending = false;
+   stopwriter = false;
+   pending.resize(buffer.size());
+   writer = std::thread(&MosdexOutputStream::backgroundWriter, this);
+}
+
+void MosdexOutputStream::backgroundWriter()
+{
+   std::unique_lock<std::mutex> lock(mutex);
+   while( true )
+   {
+      cond.wait(lock, [this] { return haspending || stopwriter; });
+      if( !haspending )
+         break;
+
+      // the buffer being filled is a different one, so it can be written without the lock
+      lock.unlock();
+      writeData(&pending[0], pendingsize);
+      lock.lock();
+
+      haspending = false;
+      cond.notify_all();
+   }
+}
+
+void MosdexOutputStream::writeBuffer()
+{
+   if( background )
+   {
+      // wait until the writer is done with the previous buffer, then swap
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [this] { return !haspending; });
+      if( pos > 0 )
+      {
+         buffer.swap(pending);
+         pendingsize = pos;
+         haspending = true;
+         cond.notify_all();
+      }
+   }
+   else
+   {
+      writeData(&buffer[0], pos);
+   }
+
+   written += pos;
+   pos = 0;
+}
+
+void MosdexOutputStream::writeData(
+   const char* data,
+   size_t      size
+)
+{
+   if( size == 0 || failed )
+      return;
+
+   switch( compression )
+   {
+      case COMPRESSION_NONE :
+         if( fwrite(data, 1, size, fp) != size )
+            failed = true;
+         break;
+
+      case COMPRESSION_GZIP :
+#ifdef HAVE_ZLIB
+         assert(size <= INT_MAX);
+         if( gzwrite((gzFile)gz, data, (unsigned)size) != (int)size )
+            failed = true;
+#endif
+         break;
+
+      case COMPRESSION_ZSTD :
+      {
+#ifdef HAVE_ZSTD
+         ZSTD_inBuffer in = { data, size, 0 };
+         while( in.pos < in.size && !failed )
+         {
+            ZSTD_outBuffer out = { &zbuffer[0], zbuffer.size(), 0 };
+            size_t rc = ZSTD_compressStream2((ZSTD_CStream*)zcs, &out, &in, ZSTD_e_continue);
+            if( ZSTD_isError(rc) )
+            {
+               std::cerr << "zstd compression failed: " << ZSTD_getErrorName(rc) << std::endl;
+               failed = true;
+            }
+            else if( fwrite(&zbuffer[0], 1, out.pos, fp) != out.pos )
+               failed = true;
+         }
+#endif
+         break;
+      }
+   }
+}
+
+bool MosdexOutputStream::close()
+{
+   if( fp == NULL && gz == NULL )
+      return !failed;
+
+   writeBuffer();
+
+   if( background )
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stopwriter = true;
+      }
+      cond.notify_all();
+      writer.join();
+      background = false;
+   }
+
+#ifdef HAVE_ZSTD
+   if( zcs != NULL )
+   {
+      // finish frame
+      size_t remaining;
+      do
+      {
+         ZSTD_inBuffer in = { NULL, 0, 0 };
+         ZSTD_outBuffer out = { &zbuffer[0], zbuffer.size(), 0 };
+         remaining = ZSTD_compressStream2((ZSTD_CStream*)zcs, &out, &in, ZSTD_e_end);
+         if( ZSTD_isError(remaining) || fwrite(&zbuffer[0], 1, out.pos, fp) != out.pos )
+         {
+            failed = true;
+            break;
+         }
+      }
+      while( remaining > 0 );
+
+      ZSTD_freeCStream((ZSTD_CStream*)zcs);
+      zcs = NULL;
+   }
+#endif
+
+#ifdef HAVE_ZLIB
+   if( gz != NULL )
+   {
+      if( gzclose((gzFile)gz) != Z_OK )
+         failed = true;
+      gz = NULL;
+   }
+#endif
+
+   if( fp != NULL )
+   {
+      if( fp == stdout ? fflush(fp) != 0 : fclose(fp) != 0 )
+         failed = true;
+      fp = NULL;
+   }
+
+   if( failed )
+      std::cerr << "Error writing output" << std::endl;
+
+   return !failed;
+}
+
+MosdexInputStream::MosdexInputStream()
+: compression(COMPRESSION_NONE), fp(NULL), gz(NULL), zds(NULL), zpos(0), zsize(0),
+  buffer(1, '\0'), current(&buffer[0]), last(&buffer[0]), readcount(0), count(0), eof(true), error(false)
+{ }
+
+MosdexInputStream::~MosdexInputStream()
+{
+   close();
+}
+
+bool MosdexInputStream::open(
+   const char* filename,
+   Compression compression_
+)
+{
+   assert(fp == NULL && gz == NULL);
+
+   if( !compressionAvailable(compression_) )
+      return false;
+
+   compression = compression_;
+   bool fromstdin = strcmp(filename, "-") == 0;
+
+#ifdef HAVE_ZLIB
+   if( compression == COMPRESSION_GZIP )
+   {
+      gz = fromstdin ? gzdopen(fileno(stdin), "rb") : gzopen(filename, "rb");
+      if( gz == NULL )
+      {
+         std::cerr << "File " << filename << " not found" << std::endl;
+         return false;
+      }
+      gzbuffer((gzFile)gz, BUFFERSIZE);
+   }
+   else
+#endif
+   {
+      fp = fromstdin ? stdin : fopen(filename, "rb");
+      if( fp == NULL )
+      {
+         std::cerr << "File " << filename << " not found" << std::endl;
+         return false;
+      }
+   }
+
+#ifdef HAVE_ZSTD
+   if( compression == COMPRESSION_ZSTD )
+   {
+      zds = ZSTD_createDStream();
+      ZSTD_initDStream((ZSTD_DStream*)zds);
+      zbuffer.resize(ZSTD_DStreamInSize());
+      zpos = zsize = 0;
+   }
+#endif
+
+   buffer.resize(BUFFERSIZE);
+   current = last = &buffer[0];
+   readcount = 0;
+   count = 0;
+   eof = false;
+   error = false;
+
+   read();
+
+   return true;
+}
+
+void MosdexInputStream::close()
+{
+#ifdef HAVE_ZSTD
+   if( zds != NULL )
+   {
+      ZSTD_freeDStream((ZSTD_DStream*)zds);
+      zds = NULL;
+   }
+#endif
+
+#ifdef HAVE_ZLIB
+   if( gz != NULL )
+   {
+      gzclose((gzFile)gz);
+      gz = NULL;
+   }
+#endif
+
+   if( fp != NULL )
+   {
+      if( fp != stdin )
+         fclose(fp);
+      fp = NULL;
+   }
+}
+
+// reads up to size decompressed bytes; returns less only at end of input or on error
+size_t MosdexInputStream::readRaw(
+   char*  dst,
+   size_t size
+)
+{
+   switch( compression )
+   {
+      case COMPRESSION_NONE :
+      {
+         size_t n = fread(dst, 1, size, fp);
+         if( n < size && ferror(fp) )
+            error = true;
+         return n;
+      }
+
+      case COMPRESSION_GZIP :
+      {
+#ifdef HAVE_ZLIB
+         int n = gzread((gzFile)gz, dst, (unsigned)size);
+         if( n < 0 )
+         {
+            error = true;
+            return 0;
+         }
+         return (size_t)n;
+#else
+         return 0;
+#endif
+      }
+
+      case COMPRESSION_ZSTD :
+      {
+#ifdef HAVE_ZSTD
+         ZSTD_outBuffer out = { dst, size, 0 };
+         bool zeof = false;
+         while( out.pos < out.size )
+         {
+            if( zpos == zsize )
+            {
+               zsize = fread(&zbuffer[0], 1, zbuffer.size(), fp);
+               zpos = 0;
+               if( zsize < zbuffer.size() )
+               {
+                  zeof = true;
+                  if( ferror(fp) )
+                     error = true;
+               }
+            }
+
+            ZSTD_inBuffer in = { &zbuffer[0], zsize, zpos };
+            size_t rc = ZSTD_decompressStream((ZSTD_DStream*)zds, &out, &in);
+            zpos = in.pos;
+            if( ZSTD_isError(rc) )
+            {
+               std::cerr << "zstd decompression failed: " << ZSTD_getErrorName(rc) << std::endl;
+               error = true;
+               break;
+            }
+
+            // decompressor flushes as much as fits, so if there is room left, it has nothing more for the input given
+            if( zeof && zpos == zsize && out.pos < out.size )
+            {
+               if( rc != 0 )
+               {
+                  std::cerr << "zstd input truncated" << std::endl;
+                  error = true;
+               }
+               break;
+            }
+         }
+         return out.pos;
+#else
+         return 0;
+#endif
+      }
+   }
+
+   return 0;
+}
+
+// advances to next character, refilling the buffer if necessary (same scheme as rapidjson::FileReadStream)
+void MosdexInputStream::read()
+{
+   if( current < last )
+   {
+      ++current;
+   }
+   else if( !eof )
+   {
+      count += readcount;
+      readcount = readRaw(&buffer[0], buffer.size());
+      last = &buffer[0] + readcount - 1;
+      current = &buffer[0];
+
+      if( readcount < buffer.size() )
+      {
+         buffer[readcount] = '\0';
+         ++last;
+         eof = true;
+      }
+   }
+}
+
+bool readContent(
+   const char*  filename,
+   Compression  compression,
+   std::string& content
+)
+{
+   MosdexInputStream is;
+   if( !is.open(filename, compression) )
+      return false;
+
+   content.clear();
+   while( !is.atEnd() )
+      content += is.Take();
+
+   if( is.failed() )
+   {
+      std::cerr << "Error reading " << filename << std::endl;
+      return false;
+   }
+
+   return true;
+}
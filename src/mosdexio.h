@@ -0,0 +1,194 @@
+#ifndef MOSDEXIO_H
+#define MOSDEXIO_H
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// streams for reading and writing MOSDEX files, optionally compressed
+// they satisfy the rapidjson stream concepts, so they can be given to rapidjson readers and writers directly
+
+typedef enum
+{
+   COMPRESSION_NONE,
+   COMPRESSION_GZIP,
+   COMPRESSION_ZSTD
+} Compression;
+
+// compression implied by the extension of a filename: .gz for gzip, .zst or .zstd for zstd
+extern
+Compression compressionFromFilename(
+   const char* filename
+);
+
+// parses a compression name as given on the command line: none, gzip, zstd
+// returns false if the name is unknown
+extern
+bool compressionFromName(
+   const char*  name,
+   Compression* compression
+);
+
+class MosdexOutputStream
+{
+public:
+   typedef char Ch;
+
+   MosdexOutputStream();
+   ~MosdexOutputStream();
+
+   // opens a file for writing, or stdout if filename is NULL or "-"
+   bool open(
+      const char* filename,
+      Compression compression
+   );
+
+   // writes remaining output and closes the file
+   // returns false if any write failed
+   bool close();
+
+   // lets a separate thread compress and write full buffers while the next one is filled
+   // to be called after open()
+   void startBackgroundWriter();
+
+   void Put(
+      Ch c
+   )
+   {
+      if( pos == buffer.size() )
+         writeBuffer();
+      buffer[pos++] = c;
+   }
+
+   // called by rapidjson when a document is complete
+   void Flush()
+   {
+      writeBuffer();
+   }
+
+   // number of (uncompressed) bytes written so far
+   size_t Tell() const
+   {
+      return written + pos;
+   }
+
+private:
+   void writeBuffer();
+   void writeData(
+      const char* data,
+      size_t      size
+   );
+   void backgroundWriter();
+
+   Compression compression;
+   FILE* fp;
+   void* gz;
+   void* zcs;
+   std::vector<char> zbuffer;
+
+   std::vector<char> buffer;
+   size_t pos;
+   size_t written;
+   bool failed;
+
+   // buffer handed to the background writer, and whether it still has to be written
+   bool background;
+   std::thread writer;
+   std::mutex mutex;
+   std::condition_variable cond;
+   std::vector<char> pending;
+   size_t pendingsize;
+   bool haspending;
+   bool stopwriter;
+};
+
+class MosdexInputStream
+{
+public:
+   typedef char Ch;
+
+   MosdexInputStream();
+   ~MosdexInputStream();
+
+   // opens a file for reading, or stdin if filename is "-"
+   bool open(
+      const char* filename,
+      Compression compression
+   );
+
+   void close();
+
+   // whether reading or decompressing failed
+   bool failed() const
+   {
+      return error;
+   }
+
+   Ch Peek() const
+   {
+      return *current;
+   }
+
+   Ch Take()
+   {
+      Ch c = *current;
+      read();
+      return c;
+   }
+
+   // whether all of the file has been taken; unlike Peek() == '\0', also for content that contains NUL bytes
+   bool atEnd() const
+   {
+      return eof && current == last;
+   }
+
+   // number of (uncompressed) bytes taken so far
+   size_t Tell() const
+   {
+      return count + (current - &buffer[0]);
+   }
+
+   // not supported: in situ parsing
+   Ch* PutBegin() { assert(false); return 0; }
+   void Put(Ch) { assert(false); }
+   void Flush() { assert(false); }
+   size_t PutEnd(Ch*) { assert(false); return 0; }
+
+private:
+   void read();
+   size_t readRaw(
+      char*  dst,
+      size_t size
+   );
+
+   Compression compression;
+   FILE* fp;
+   void* gz;
+   void* zds;
+   std::vector<char> zbuffer;
+   size_t zpos;
+   size_t zsize;
+
+   std::vector<char> buffer;
+   Ch* current;
+   Ch* last;
+   size_t readcount;
+   size_t count;
+   bool eof;
+   bool error;
+};
+
+// reads the whole content of a file, decompressed as given (e.g., for a temporary file, as its final name implies)
+// returns false if it cannot be read
+extern
+bool readContent(
+   const char*  filename,
+   Compression  compression,
+   std::string& content
+);
+
+#endif
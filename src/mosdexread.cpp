@@ -0,0 +1,1865 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+#include <vector>
+#include <set>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "mosdexread.h"
+#include "mosdexbin.h"
+#include "mosdexcache.h"
+
+#include "rapidjson/error/en.h"
+
+using namespace rapidjson;
+
+// schemas resolved so far, by table name
+static std::map<std::string, Schema> schemas;
+
+// index table of each variable and constraint, by "VARIABLES" or "CONSTRAINTS", then by name
+static std::map<std::string, std::map<std::string, std::string> > symbolindex;
+
+const Schema& addSchema(
+   const std::string& table,
+   const Value&       decl
+   )
+{
+   auto it = schemas.find(table);
+   if( it != schemas.end() )
+      return it->second;
+
+   Schema& schema = schemas[table];
+
+   std::set<std::string> other;
+   for( Value::ConstMemberIterator itr = decl.MemberBegin(); itr != decl.MemberEnd(); ++itr )
+   {
+      // keynames are identfied by leading '*'
+      if( *itr->name.GetString() == '*' )
+      {
+         assert(itr->value.IsString());
+         assert(itr->value == "String");
+
+         if( !schema.keys.empty() )
+            schema.domstr += ", ";
+         schema.keys.push_back(std::string(itr->name.GetString() + 1));
+         schema.domstr += schema.keys.back();
+      }
+      else
+      {
+         assert(itr->value.IsString());
+         assert(itr->value == "Double");
+
+         other.insert(itr->name.GetString());
+      }
+   }
+   schema.other.assign(other.begin(), other.end());
+   schema.isset = other.empty();
+
+   return schema;
+}
+
+const Schema& getSchema(
+   Document&          d,
+   const std::string& table
+   )
+{
+   auto it = schemas.find(table);
+   if( it != schemas.end() )
+      return it->second;
+
+   // member lookup is linear in the number of tables, so it is done once per table
+   assert(d["INPUT_DATA_MODEL"].HasMember(table));
+   return addSchema(table, d["INPUT_DATA_MODEL"][table]);
+}
+
+const Schema& getSymbolSchema(
+   Document&          d,
+   const std::string& entity,
+   const std::string& name
+   )
+{
+   auto it = symbolindex.find(entity);
+   if( it == symbolindex.end() )
+   {
+      it = symbolindex.insert(std::make_pair(entity, std::map<std::string, std::string>())).first;
+      auto& syms = d[entity];
+      for( Value::ConstValueIterator itr = syms.Begin(); itr != syms.End(); ++itr )
+         it->second[(*itr)["NAME"].GetString()] = (*itr)["INDEX"].GetString();
+   }
+
+   assert(it->second.count(name) > 0);
+   return getSchema(d, it->second[name]);
+}
+
+// binary DATA file, if the document refers to one
+static MosdexBinaryReader binarydata;
+
+std::set<std::string> selection;
+
+bool isSelected(
+   const std::string& name
+   )
+{
+   return selection.empty() || selection.count(name) > 0;
+}
+
+// rows of a JSON-Lines DATA file, for a given order of key and value columns
+class Shard
+{
+public:
+   std::vector<std::string> keys;
+   std::vector<std::string> other;
+
+   // labels of key columns and values of value columns (NOVALUE if not given), row after row
+   std::vector<std::string> labels;
+   std::vector<double> vals;
+   size_t nrows = 0;
+
+   bool ok = false;
+};
+
+// parsed JSON-Lines DATA files, by name as given in the document
+static std::map<std::string, Shard> shards;
+
+// see mosdexread.h for the layouts
+void forEachRow(
+   Document&                       d,
+   const Value&                    table,
+   const std::vector<std::string>& keys,
+   const std::vector<std::string>& other,
+   const RowCallback&              f
+   )
+{
+   std::vector<const char*> labels(keys.size());
+   std::vector<double> vals(other.size());
+
+   if( table.IsArray() )
+   {
+      for( Value::ConstValueIterator itr = table.Begin(); itr != table.End(); ++itr )
+      {
+         assert(itr->IsObject());
+         for( size_t k = 0; k < keys.size(); ++k )
+         {
+            assert(itr->HasMember(keys[k]));
+            labels[k] = (*itr)[keys[k]].GetString();
+         }
+         for( size_t o = 0; o < other.size(); ++o )
+            vals[o] = itr->HasMember(other[o]) ? (*itr)[other[o]].GetDouble() : NOVALUE;
+
+         f(labels, vals);
+      }
+      return;
+   }
+
+   assert(table.IsObject());
+
+   if( table.HasMember("LAYOUT") && table["LAYOUT"] == "SHARDED" )
+   {
+      auto& files = table["SHARDS"];
+      assert(files.IsArray());
+      for( Value::ConstValueIterator itr = files.Begin(); itr != files.End(); ++itr )
+      {
+         auto sitr = shards.find(itr->GetString());
+         assert(sitr != shards.end() && sitr->second.ok);
+         const Shard& shard = sitr->second;
+         assert(shard.keys == keys);
+
+         // the shard has all value columns of the schema, the caller may ask for some of them
+         std::vector<int> valpos(other.size(), -1);
+         for( size_t o = 0; o < other.size(); ++o )
+            for( size_t v = 0; v < shard.other.size(); ++v )
+               if( shard.other[v] == other[o] )
+                  valpos[o] = (int)v;
+
+         for( size_t r = 0; r < shard.nrows; ++r )
+         {
+            for( size_t k = 0; k < keys.size(); ++k )
+               labels[k] = shard.labels[r * keys.size() + k].c_str();
+            for( size_t o = 0; o < other.size(); ++o )
+               vals[o] = valpos[o] >= 0 ? shard.vals[r * shard.other.size() + valpos[o]] : NOVALUE;
+
+            f(labels, vals);
+         }
+      }
+      return;
+   }
+
+   if( table.HasMember("LAYOUT") && table["LAYOUT"] == "BINARY" )
+   {
+      assert(binarydata.isOpen());
+      uint32_t t = table["TABLE"].GetUint();
+      assert(t < binarydata.ntables());
+      const MosdexBinTocEntry& toc = binarydata.table(t);
+      assert(toc.nkeys == keys.size());
+
+      // columns are read in place from the mapped file
+      std::vector<const uint32_t*> keycols;
+      for( uint32_t k = 0; k < toc.nkeys; ++k )
+         keycols.push_back(binarydata.keyColumn(t, k));
+
+      auto& colnames = table["VALUES"];
+      assert(colnames.IsArray() && colnames.Size() == toc.nvalues);
+      std::vector<const double*> valcols(other.size(), NULL);
+      for( size_t o = 0; o < other.size(); ++o )
+         for( uint32_t v = 0; v < toc.nvalues; ++v )
+            if( colnames[v] == other[o] )
+               valcols[o] = binarydata.valueColumn(t, v);
+
+      for( uint64_t r = 0; r < toc.nrows; ++r )
+      {
+         for( size_t k = 0; k < keys.size(); ++k )
+            labels[k] = binarydata.uelLabel(keycols[k][r]);
+         for( size_t o = 0; o < other.size(); ++o )
+            vals[o] = valcols[o] != NULL ? valcols[o][r] : NOVALUE;
+
+         f(labels, vals);
+      }
+      return;
+   }
+
+   // value columns are arrays indexed by row; columns without any value may be omitted
+   std::vector<const Value*> valcols(other.size(), NULL);
+   for( size_t o = 0; o < other.size(); ++o )
+   {
+      if( table.HasMember(other[o]) )
+         valcols[o] = &table[other[o]];
+      else if( table.HasMember("COLUMNS") && table["COLUMNS"].HasMember(other[o]) )
+         valcols[o] = &table["COLUMNS"][other[o]];
+      assert(valcols[o] == NULL || valcols[o]->IsArray());
+   }
+
+   // counts are size_t; a JSON array itself cannot have more than 2^32-1 elements (rapidjson SizeType),
+   // larger tables are in a binary DATA file or in JSON-Lines files
+   auto rowvals = [&](size_t r)
+   {
+      for( size_t o = 0; o < other.size(); ++o )
+      {
+         vals[o] = NOVALUE;
+         if( valcols[o] != NULL )
+         {
+            assert(r < valcols[o]->Size());
+            const Value& val = (*valcols[o])[(SizeType)r];
+            if( !val.IsNull() )
+               vals[o] = val.GetDouble();
+         }
+      }
+   };
+
+   if( table.HasMember("LAYOUT") && table["LAYOUT"] == "DENSE" )
+   {
+      auto& axes = table["AXES"];
+      assert(axes.IsObject());
+
+      std::vector<const Value*> axis;
+      uint64_t nrows = 1;
+      for( auto& key : keys )
+      {
+         assert(axes.HasMember(key));
+         assert(axes[key].IsArray());
+         axis.push_back(&axes[key]);
+         nrows *= axes[key].Size();
+      }
+
+      // row-major: last key runs fastest
+      std::vector<SizeType> pos(keys.size(), 0);
+      for( uint64_t r = 0; r < nrows; ++r )
+      {
+         for( size_t k = 0; k < keys.size(); ++k )
+            labels[k] = (*axis[k])[pos[k]].GetString();
+         rowvals(r);
+
+         f(labels, vals);
+
+         for( size_t k = keys.size(); k > 0; --k )
+         {
+            if( ++pos[k-1] < axis[k-1]->Size() )
+               break;
+            pos[k-1] = 0;
+         }
+      }
+      return;
+   }
+
+   if( table.HasMember("LAYOUT") && table["LAYOUT"] == "PATTERN" )
+   {
+      // key labels are taken positionally from the rows of the referenced table
+      std::string patname = table["PATTERN"].GetString();
+      assert(d["DATA"].HasMember(patname));
+      const std::vector<std::string>& patkeys = getSchema(d, patname).keys;
+      assert(patkeys.size() == keys.size());
+
+      size_t r = 0;
+      forEachRow(d, d["DATA"][patname], patkeys, std::vector<std::string>(),
+         [&](const std::vector<const char*>& patlabels, const std::vector<double>&)
+         {
+            rowvals(r++);
+            f(patlabels, vals);
+         });
+      return;
+   }
+
+   assert(table.HasMember("ROWS"));
+   assert(table.HasMember("COLUMNS"));
+
+   auto& columns = table["COLUMNS"];
+   assert(columns.IsObject());
+   uint64_t nrows = table["ROWS"].GetUint64();
+
+   const Value* dict = NULL;
+   if( table.HasMember("DICTIONARY") )
+   {
+      dict = &table["DICTIONARY"];
+      assert(dict->IsArray());
+   }
+
+   std::vector<const Value*> keycols;
+   for( auto& key : keys )
+   {
+      assert(columns.HasMember(key));
+      assert(columns[key].IsArray() && columns[key].Size() == nrows);
+      keycols.push_back(&columns[key]);
+   }
+
+   for( uint64_t r = 0; r < nrows; ++r )
+   {
+      for( size_t k = 0; k < keys.size(); ++k )
+      {
+         const Value& label = (*keycols[k])[(SizeType)r];
+         if( label.IsString() )
+         {
+            labels[k] = label.GetString();
+         }
+         else
+         {
+            assert(dict != NULL && label.IsUint() && label.GetUint() < dict->Size());
+            labels[k] = (*dict)[label.GetUint()].GetString();
+         }
+      }
+      rowvals(r);
+
+      f(labels, vals);
+   }
+}
+
+// path of a file that a document refers to relative to its own directory
+static
+std::string relativeTo(
+   const std::string& infile,
+   const std::string& name
+   )
+{
+   if( name[0] == '/' || infile.find_last_of('/') == std::string::npos )
+      return name;
+   return infile.substr(0, infile.find_last_of('/') + 1) + name;
+}
+
+static
+void parseShard(
+   const std::string& path,
+   Shard&             shard
+   )
+{
+   MosdexInputStream is;
+   if( !is.open(path.c_str(), compressionFromFilename(path.c_str())) )
+      return;
+
+   // one row object per line
+   while( true )
+   {
+      while( isspace(is.Peek()) )
+         is.Take();
+      if( is.Peek() == '\0' )
+         break;
+
+      Document row;
+      if( row.ParseStream<kParseStopWhenDoneFlag>(is).HasParseError() || !row.IsObject() )
+      {
+         std::cerr << "Error(" << path << ", offset " << is.Tell() << "): " << GetParseError_En(row.GetParseError()) << std::endl;
+         return;
+      }
+
+      for( auto& key : shard.keys )
+      {
+         if( !row.HasMember(key) || !row[key].IsString() )
+         {
+            std::cerr << "Error(" << path << ", offset " << is.Tell() << "): missing key " << key << " or not a string" << std::endl;
+            return;
+         }
+         shard.labels.push_back(row[key].GetString());
+      }
+      for( auto& o : shard.other )
+      {
+         if( row.HasMember(o) && !row[o].IsNumber() )
+         {
+            std::cerr << "Error(" << path << ", offset " << is.Tell() << "): value " << o << " is not a number" << std::endl;
+            return;
+         }
+         shard.vals.push_back(row.HasMember(o) ? row[o].GetDouble() : NOVALUE);
+      }
+      ++shard.nrows;
+   }
+
+   if( is.failed() )
+   {
+      std::cerr << "Error reading " << path << std::endl;
+      return;
+   }
+
+   shard.ok = true;
+}
+
+// parses the JSON-Lines files of all selected sharded DATA tables, using up to nthreads threads
+// rows keep the order of the files in the document, so the result does not depend on the number of threads
+static
+bool loadShards(
+   Document&   d,
+   const char* infile,
+   unsigned    nthreads
+   )
+{
+   if( !d.HasMember("DATA") )
+      return true;
+
+   std::vector<std::pair<std::string, Shard*> > jobs;
+
+   auto& data = d["DATA"];
+   for( Value::ConstMemberIterator itr = data.MemberBegin(); itr != data.MemberEnd(); ++itr )
+   {
+      if( !isSelected(itr->name.GetString()) || !itr->value.IsObject() || !itr->value.HasMember("LAYOUT") || itr->value["LAYOUT"] != "SHARDED" )
+         continue;
+
+      // key and value columns in the order that processData uses
+      const Schema& schema = getSchema(d, itr->name.GetString());
+
+      auto& files = itr->value["SHARDS"];
+      for( Value::ConstValueIterator fitr = files.Begin(); fitr != files.End(); ++fitr )
+      {
+         Shard& shard = shards[fitr->GetString()];
+         shard.keys = schema.keys;
+         shard.other = schema.other;
+         jobs.push_back(std::make_pair(relativeTo(infile, fitr->GetString()), &shard));
+      }
+   }
+
+   std::atomic<size_t> next(0);
+   auto worker = [&]()
+   {
+      for( size_t j = next++; j < jobs.size(); j = next++ )
+         parseShard(jobs[j].first, *jobs[j].second);
+   };
+
+   std::vector<std::thread> threads;
+   for( unsigned t = 1; t < nthreads && t < jobs.size(); ++t )
+      threads.push_back(std::thread(worker));
+   worker();
+   for( auto& t : threads )
+      t.join();
+
+   for( auto& job : jobs )
+      if( !job.second->ok )
+         return false;
+
+   return true;
+}
+
+// file of the sections that do not depend on the data, instead of the one that PROBLEM.STRUCTURE refers to, if not NULL
+static const char* structurefile = NULL;
+
+// adds the sections of the structure file that PROBLEM.STRUCTURE refers to, as written by gams2mosdex -structure,
+// after checking that its content hash is PROBLEM.FINGERPRINT
+static
+bool resolveStructure(
+   Document&   d,
+   const char* infile
+   )
+{
+   if( !d.IsObject() || !d.HasMember("PROBLEM") || !d["PROBLEM"].IsObject() || !d["PROBLEM"].HasMember("STRUCTURE") )
+   {
+      if( structurefile != NULL )
+         std::cerr << infile << " does not refer to a structure file, ignoring " << structurefile << std::endl;
+      return true;
+   }
+
+   auto& problem = d["PROBLEM"];
+   if( !problem["STRUCTURE"].IsString() || !problem.HasMember("FINGERPRINT") || !problem["FINGERPRINT"].IsString() )
+   {
+      std::cerr << "Error at PROBLEM: STRUCTURE and FINGERPRINT have to be strings" << std::endl;
+      return false;
+   }
+
+   // path as given, relative to the directory of the document
+   std::string filename = structurefile != NULL ? std::string(structurefile) : relativeTo(infile, problem["STRUCTURE"].GetString());
+
+   std::string content;
+   if( !readContent(filename.c_str(), compressionFromFilename(filename.c_str()), content) )
+      return false;
+
+   ContentHash h;
+   h.add(content.data(), content.size());
+   if( h.hex() != problem["FINGERPRINT"].GetString() )
+   {
+      std::cerr << filename << " is not the structure that " << infile << " was written for, fingerprints differ" << std::endl;
+      return false;
+   }
+
+   // parse with the allocator of d, so that sections can be moved into d
+   Document structure(&d.GetAllocator());
+   if( structure.Parse(content.data(), content.size()).HasParseError() || !structure.IsObject() )
+   {
+      std::cerr << "Error(" << filename << ", offset " << structure.GetErrorOffset() << "): " << GetParseError_En(structure.GetParseError()) << std::endl;
+      return false;
+   }
+
+   for( Value::MemberIterator itr = structure.MemberBegin(); itr != structure.MemberEnd(); ++itr )
+   {
+      if( d.HasMember(itr->name) )
+      {
+         std::cerr << "Section " << itr->name.GetString() << " is in " << infile << " and in " << filename << std::endl;
+         return false;
+      }
+      Value name(itr->name, d.GetAllocator());
+      d.AddMember(name, itr->value, d.GetAllocator());
+   }
+
+   return true;
+}
+
+// replaces DATA tables with LAYOUT BASE by the tables of the export that PROBLEM.BASE refers to,
+// as written by gams2mosdex -base; the base may refer to a base itself
+static
+bool resolveBase(
+   Document&   d,
+   const char* infile
+   )
+{
+   if( !d.HasMember("PROBLEM") || !d["PROBLEM"].HasMember("BASE") || !d.HasMember("DATA") )
+      return true;
+
+   // path of the base as given, relative to the directory of the document
+   std::string basename = d["PROBLEM"]["BASE"].GetString();
+   std::string basefile = relativeTo(infile, basename);
+
+   MosdexInputStream is;
+   if( !is.open(basefile.c_str(), compressionFromFilename(basefile.c_str())) )
+      return false;
+
+   // parse with the allocator of d, so that tables can be moved into d
+   Document base(&d.GetAllocator());
+   if( base.ParseStream(is).HasParseError() || is.failed() || !base.IsObject() )
+   {
+      std::cerr << "Error reading " << basefile << std::endl;
+      return false;
+   }
+   is.close();
+
+   if( !resolveBase(base, basefile.c_str()) )
+      return false;
+
+   if( base.HasMember("PROBLEM") && base["PROBLEM"].HasMember("DATA_FILE") )
+   {
+      std::cerr << "Cannot take DATA tables from " << basefile << ", it has a binary DATA file" << std::endl;
+      return false;
+   }
+
+   auto& data = d["DATA"];
+   for( Value::MemberIterator itr = data.MemberBegin(); itr != data.MemberEnd(); ++itr )
+   {
+      if( !itr->value.IsObject() || !itr->value.HasMember("LAYOUT") || itr->value["LAYOUT"] != "BASE" )
+         continue;
+
+      if( !base.HasMember("DATA") || !base["DATA"].HasMember(itr->name) )
+      {
+         std::cerr << "DATA table " << itr->name.GetString() << " not found in " << basefile << std::endl;
+         return false;
+      }
+
+      Value& table = base["DATA"][itr->name];
+
+      // JSON-Lines files are given relative to the directory of the base
+      if( table.IsObject() && table.HasMember("LAYOUT") && table["LAYOUT"] == "SHARDED" )
+         for( Value::ValueIterator fitr = table["SHARDS"].Begin(); fitr != table["SHARDS"].End(); ++fitr )
+            fitr->SetString(relativeTo(basename, fitr->GetString()), d.GetAllocator());
+
+      itr->value = table;
+   }
+
+   return true;
+}
+
+// adds to the selection what the selected symbols need: variables of selected constraints,
+// the DATA tables of selected symbols and of their coefficients
+// DATA tables that take their key labels from another table need to be added by addPatternTables
+static
+void expandSelection(
+   Document& d
+   )
+{
+   if( selection.empty() )
+      return;
+
+   std::set<std::string> added;
+
+   if( !d.HasMember("COEFFICIENTS") || !d.HasMember("VARIABLES") || !d.HasMember("CONSTRAINTS") )
+      return;
+
+   auto& coefs = d["COEFFICIENTS"];
+   for( Value::ConstValueIterator itr = coefs.Begin(); itr != coefs.End(); ++itr )
+   {
+      if( !itr->HasMember("CONSTRAINTS") || selection.count((*itr)["CONSTRAINTS"].GetString()) == 0 )
+         continue;
+
+      added.insert((*itr)["VARIABLES"].GetString());
+
+      // ENTRIES is <table>.val, or a number
+      if( (*itr)["ENTRIES"].IsString() )
+      {
+         std::string entries = (*itr)["ENTRIES"].GetString();
+         added.insert(entries.substr(0, entries.find('.')));
+      }
+   }
+
+   const char* sections[] = { "VARIABLES", "CONSTRAINTS" };
+   for( const char* section : sections )
+   {
+      auto& syms = d[section];
+      for( Value::ConstValueIterator itr = syms.Begin(); itr != syms.End(); ++itr )
+      {
+         if( selection.count((*itr)["NAME"].GetString()) > 0 || added.count((*itr)["NAME"].GetString()) > 0 )
+            added.insert((*itr)["INDEX"].GetString());
+      }
+   }
+
+   selection.insert(added.begin(), added.end());
+}
+
+// adds tables to the selection whose rows give the key labels of selected tables, see forEachRow
+// returns whether a table was added
+static
+bool addPatternTables(
+   Document& d
+   )
+{
+   bool added = false;
+
+   if( !d.HasMember("DATA") )
+      return false;
+
+   auto& data = d["DATA"];
+   for( Value::ConstMemberIterator itr = data.MemberBegin(); itr != data.MemberEnd(); ++itr )
+   {
+      if( !isSelected(itr->name.GetString()) || !itr->value.IsObject() || !itr->value.HasMember("PATTERN") )
+         continue;
+
+      if( selection.insert(itr->value["PATTERN"].GetString()).second )
+         added = true;
+   }
+
+   return added;
+}
+
+// errors found when validating a document; only the first MAXREPORTED are printed
+#define MAXREPORTED 20
+
+static size_t nerrors = 0;
+
+// DATA tables that selected symbols and coefficient blocks refer to, with the location of the reference,
+// to be checked for presence once the DATA tables are loaded
+static std::vector<std::pair<std::string, std::string> > tablerefs;
+
+static
+void reportError(
+   const std::string& where,
+   const std::string& what
+   )
+{
+   if( nerrors++ < MAXREPORTED )
+      std::cerr << "Error at " << where << ": " << what << std::endl;
+}
+
+// location of an element of an array section, with its name if it has one
+static
+std::string itemPath(
+   const char*  section,
+   SizeType     i,
+   const Value& item
+   )
+{
+   std::string path = std::string(section) + "[" + std::to_string(i) + "]";
+   if( item.IsObject() && item.HasMember("NAME") && item["NAME"].IsString() )
+      path += " (" + std::string(item["NAME"].GetString()) + ")";
+   return path;
+}
+
+// whether obj has a member name that is a string, reports an error if not
+static
+bool checkString(
+   const Value&       obj,
+   const char*        name,
+   const std::string& path
+   )
+{
+   if( obj.HasMember(name) && obj[name].IsString() )
+      return true;
+   reportError(path, std::string(name) + (obj.HasMember(name) ? " is not a string" : " is missing"));
+   return false;
+}
+
+static
+bool checkSchemas(
+   Document& d
+   )
+{
+   if( !d.HasMember("INPUT_DATA_MODEL") || !d["INPUT_DATA_MODEL"].IsObject() )
+   {
+      reportError("INPUT_DATA_MODEL", "missing or not an object");
+      return false;
+   }
+
+   bool ok = true;
+   auto& inputdata = d["INPUT_DATA_MODEL"];
+   for( Value::ConstMemberIterator itr = inputdata.MemberBegin(); itr != inputdata.MemberEnd(); ++itr )
+   {
+      std::string path = std::string("INPUT_DATA_MODEL.") + itr->name.GetString();
+      if( !itr->value.IsObject() )
+      {
+         reportError(path, "not an object");
+         ok = false;
+         continue;
+      }
+
+      // key columns are marked by a leading '*'
+      for( Value::ConstMemberIterator citr = itr->value.MemberBegin(); citr != itr->value.MemberEnd(); ++citr )
+      {
+         const char* type = *citr->name.GetString() == '*' ? "String" : "Double";
+         if( citr->value != type )
+         {
+            reportError(path + "." + citr->name.GetString(), std::string("type is not ") + type);
+            ok = false;
+         }
+      }
+   }
+
+   return ok;
+}
+
+// a LOWER, UPPER, or RHS: a number, or a string that is a number or "<symbol>.<col>" for a value column of the index table
+// table is the DATA table whose value columns v may refer to, or empty if none
+static
+void checkValue(
+   Document&          d,
+   const Value&       v,
+   const std::string& table,
+   const std::string& path
+   )
+{
+   if( v.IsNumber() )
+      return;
+   if( !v.IsString() )
+   {
+      reportError(path, "neither a number nor a string");
+      return;
+   }
+
+   const char* str = v.GetString();
+   char* end;
+   strtod(str, &end);
+   if( end != str && *end == '\0' )
+      return;
+
+   const char* dot = strchr(str, '.');
+   if( dot == NULL || table.empty() )
+   {
+      reportError(path, std::string("'") + str + "' is neither a number nor a column of the index table");
+      return;
+   }
+
+   const std::vector<std::string>& other = getSchema(d, table).other;
+   if( !std::binary_search(other.begin(), other.end(), std::string(dot + 1)) )
+      reportError(path, std::string("'") + (dot + 1) + "' is not a value column of DATA table " + table);
+}
+
+// checks the elements of VARIABLES, CONSTRAINTS, or DECISION_EXPRESSIONS, and records their index tables in symbols
+static
+void checkSymbols(
+   Document&                            d,
+   const char*                          section,
+   std::map<std::string, std::string>&  symbols,
+   std::map<std::string, const char*>&  sectionof
+   )
+{
+   if( !d.HasMember(section) )
+   {
+      if( strcmp(section, "DECISION_EXPRESSIONS") != 0 )
+         reportError(section, "missing");
+      return;
+   }
+   if( !d[section].IsArray() )
+   {
+      reportError(section, "not an array");
+      return;
+   }
+
+   auto& syms = d[section];
+   for( SizeType i = 0; i < syms.Size(); ++i )
+   {
+      auto& sym = syms[i];
+      std::string path = itemPath(section, i, sym);
+      if( !sym.IsObject() )
+      {
+         reportError(path, "not an object");
+         continue;
+      }
+      if( !checkString(sym, "NAME", path) || !checkString(sym, "INDEX", path) )
+         continue;
+
+      std::string name = sym["NAME"].GetString();
+      std::string index = sym["INDEX"].GetString();
+      if( !sectionof.insert(std::make_pair(name, section)).second )
+      {
+         reportError(path, "name is also used in " + std::string(sectionof[name]));
+         continue;
+      }
+
+      if( index != "self" )
+      {
+         if( !d["INPUT_DATA_MODEL"].HasMember(index) )
+         {
+            reportError(path + ".INDEX", "DATA table " + index + " is not declared in INPUT_DATA_MODEL");
+            continue;
+         }
+         tablerefs.push_back(std::make_pair(index, path + ".INDEX"));
+      }
+      symbols[name] = index;
+
+      // a scalar may have its values in a DATA table of its name without key columns, see forEachEntry
+      std::string values = index;
+      if( index == "self" )
+      {
+         values.clear();
+         if( d["INPUT_DATA_MODEL"].HasMember(name) )
+         {
+            if( !getSchema(d, name).keys.empty() )
+               reportError(path, "DATA table " + name + " of a scalar has key columns");
+            else
+            {
+               values = name;
+               tablerefs.push_back(std::make_pair(name, path));
+            }
+         }
+      }
+
+      if( sym.HasMember("TYPE") && !sym["TYPE"].IsString() )
+         reportError(path + ".TYPE", "not a string");
+      else if( sym.HasMember("TYPE") && strcmp(section, "VARIABLES") == 0 && strcasecmp(sym["TYPE"].GetString(), "continuous") != 0
+         && strcasecmp(sym["TYPE"].GetString(), "integer") != 0 && strcasecmp(sym["TYPE"].GetString(), "binary") != 0 )
+         reportError(path + ".TYPE", std::string("unknown variable type ") + sym["TYPE"].GetString());
+
+      if( sym.HasMember("BOUNDS") )
+      {
+         auto& bounds = sym["BOUNDS"];
+         if( !bounds.IsObject() )
+            reportError(path + ".BOUNDS", "not an object");
+         else
+         {
+            if( bounds.HasMember("LOWER") )
+               checkValue(d, bounds["LOWER"], values, path + ".BOUNDS.LOWER");
+            if( bounds.HasMember("UPPER") )
+               checkValue(d, bounds["UPPER"], values, path + ".BOUNDS.UPPER");
+         }
+      }
+
+      if( sym.HasMember("RHS") )
+      {
+         checkValue(d, sym["RHS"], values, path + ".RHS");
+         // whether the RHS is a lower or an upper bound, see forEachConstraintEntry
+         if( !sym.HasMember("SENSE") )
+            reportError(path + ".RHS", "given without SENSE");
+      }
+
+      if( sym.HasMember("SENSE") )
+      {
+         bool objective = strcmp(section, "DECISION_EXPRESSIONS") == 0;
+         if( !sym["SENSE"].IsString() )
+            reportError(path + ".SENSE", "not a string");
+         else if( objective ? sym["SENSE"] != "minimize" && sym["SENSE"] != "maximize"
+            : sym["SENSE"] != "==" && sym["SENSE"] != ">=" && sym["SENSE"] != "<=" )
+            reportError(path + ".SENSE", std::string("unknown sense ") + sym["SENSE"].GetString());
+      }
+   }
+}
+
+// whether a CONDITION is of the form "var.vdom == con.edom and ...", as parseCondition expects
+static
+bool isCondition(
+   const std::string& cond
+   )
+{
+   size_t pos = 0;
+   while( pos < cond.size() )
+   {
+      size_t andpos = cond.find(" and ", pos);
+      if( andpos == std::string::npos )
+         andpos = cond.size();
+
+      std::string eq(cond, pos, andpos - pos);
+      size_t seppos = eq.find(" == ");
+      if( seppos == std::string::npos || eq.find('.') > seppos || eq.find('.', seppos) == std::string::npos )
+         return false;
+
+      pos = andpos + 5;
+   }
+   return true;
+}
+
+static
+void checkCoefficients(
+   Document&                                 d,
+   const std::map<std::string, std::string>& symbols,
+   const std::map<std::string, const char*>& sectionof
+   )
+{
+   if( !d.HasMember("COEFFICIENTS") || !d["COEFFICIENTS"].IsArray() )
+   {
+      reportError("COEFFICIENTS", "missing or not an array");
+      return;
+   }
+
+   auto keysOf = [&](const std::string& sym)
+   {
+      const std::string& index = symbols.at(sym);
+      return index == "self" ? std::vector<std::string>() : getSchema(d, index).keys;
+   };
+
+   auto& coefs = d["COEFFICIENTS"];
+   for( SizeType i = 0; i < coefs.Size(); ++i )
+   {
+      auto& coef = coefs[i];
+      std::string path = itemPath("COEFFICIENTS", i, coef);
+      if( !coef.IsObject() )
+      {
+         reportError(path, "not an object");
+         continue;
+      }
+
+      // blocks without constraint are skipped by the converters
+      if( !coef.HasMember("CONSTRAINTS") )
+         continue;
+      if( !checkString(coef, "CONSTRAINTS", path) || !checkString(coef, "VARIABLES", path) )
+         continue;
+
+      std::string con = coef["CONSTRAINTS"].GetString();
+      std::string var = coef["VARIABLES"].GetString();
+      path += " (" + con + ", " + var + ")";
+
+      auto conitr = sectionof.find(con);
+      auto varitr = sectionof.find(var);
+      if( conitr == sectionof.end() || strcmp(conitr->second, "VARIABLES") == 0 || symbols.count(con) == 0 )
+      {
+         reportError(path + ".CONSTRAINTS", con + " is not a constraint or objective");
+         continue;
+      }
+      if( varitr == sectionof.end() || strcmp(varitr->second, "VARIABLES") != 0 || symbols.count(var) == 0 )
+      {
+         reportError(path + ".VARIABLES", var + " is not a variable");
+         continue;
+      }
+
+      std::vector<std::string> condom = keysOf(con);
+      std::vector<std::string> vardom = keysOf(var);
+      std::vector<bool> conditioned(vardom.size(), false);
+
+      if( coef.HasMember("CONDITION") )
+      {
+         if( !coef["CONDITION"].IsString() || !isCondition(coef["CONDITION"].GetString()) )
+         {
+            reportError(path + ".CONDITION", "not of the form \"var.dom == con.dom and ...\"");
+            continue;
+         }
+
+         bool ok = true;
+         for( auto& p : parseCondition(coef["CONDITION"].GetString()) )
+         {
+            ptrdiff_t v = std::find(vardom.begin(), vardom.end(), p.first) - vardom.begin();
+            if( v == (ptrdiff_t)vardom.size() || std::find(condom.begin(), condom.end(), p.second) == condom.end() )
+            {
+               reportError(path + ".CONDITION", p.first + " == " + p.second + " does not pair a domain of " + var + " with one of " + con);
+               ok = false;
+               break;
+            }
+            conditioned[v] = true;
+         }
+         if( !ok )
+            continue;
+      }
+
+      if( !coef.HasMember("ENTRIES") || (!coef["ENTRIES"].IsNumber() && !coef["ENTRIES"].IsString()) )
+      {
+         reportError(path + ".ENTRIES", "missing, or neither a number nor a string");
+         continue;
+      }
+      if( coef["ENTRIES"].IsNumber() )
+         continue;
+
+      // "table.col" with the constraint domains and the variable domains that are not conditioned as keys
+      std::string entries = coef["ENTRIES"].GetString();
+      size_t dot = entries.find('.');
+      std::string table = entries.substr(0, dot);
+      if( dot == std::string::npos || !d["INPUT_DATA_MODEL"].HasMember(table) )
+      {
+         reportError(path + ".ENTRIES", "'" + entries + "' is not a column of a declared DATA table");
+         continue;
+      }
+
+      const Schema& schema = getSchema(d, table);
+      if( !std::binary_search(schema.other.begin(), schema.other.end(), entries.substr(dot + 1)) )
+      {
+         reportError(path + ".ENTRIES", "'" + entries.substr(dot + 1) + "' is not a value column of DATA table " + table);
+         continue;
+      }
+
+      std::vector<std::string> needed(condom);
+      for( size_t v = 0; v < vardom.size(); ++v )
+         if( !conditioned[v] )
+            needed.push_back(vardom[v]);
+      for( auto& key : needed )
+         if( std::find(schema.keys.begin(), schema.keys.end(), key) == schema.keys.end() )
+            reportError(path + ".ENTRIES", "DATA table " + table + " has no key column " + key);
+
+      tablerefs.push_back(std::make_pair(table, path + ".ENTRIES"));
+   }
+}
+
+// checks the sections of a document before anything relies on them:
+// members and their types, and the DATA tables and columns that symbols and coefficient blocks refer to
+// DATA tables themselves are checked by checkData
+// returns false on error
+static
+bool checkStructure(
+   Document& d
+   )
+{
+   tablerefs.clear();
+
+   if( !d.IsObject() )
+   {
+      reportError("document", "not an object");
+      return false;
+   }
+
+   if( d.HasMember("PROBLEM") )
+   {
+      auto& problem = d["PROBLEM"];
+      if( !problem.IsObject() )
+         reportError("PROBLEM", "not an object");
+      else
+      {
+         const char* members[] = { "NAME", "BASE", "DATA_FILE" };
+         for( const char* m : members )
+            if( problem.HasMember(m) )
+               checkString(problem, m, "PROBLEM");
+      }
+   }
+
+   if( !checkSchemas(d) )
+      return false;
+
+   std::map<std::string, std::string> symbols;
+   std::map<std::string, const char*> sectionof;
+   checkSymbols(d, "VARIABLES", symbols, sectionof);
+   checkSymbols(d, "CONSTRAINTS", symbols, sectionof);
+   checkSymbols(d, "DECISION_EXPRESSIONS", symbols, sectionof);
+   checkCoefficients(d, symbols, sectionof);
+
+   if( !d.HasMember("DATA") || !d["DATA"].IsObject() )
+      reportError("DATA", "missing or not an object");
+
+   return nerrors == 0;
+}
+
+// checks an array of values of a value column: numbers, or null if not given for a row
+static
+void checkValueColumn(
+   const Value&       col,
+   uint64_t           nrows,
+   const std::string& path
+   )
+{
+   if( !col.IsArray() || col.Size() != nrows )
+   {
+      reportError(path, "not an array of " + std::to_string(nrows) + " values");
+      return;
+   }
+   for( SizeType r = 0; r < col.Size(); ++r )
+      if( !col[r].IsNumber() && !col[r].IsNull() )
+      {
+         reportError(path + "[" + std::to_string(r) + "]", "neither a number nor null");
+         return;
+      }
+}
+
+// checks the rows of a DATA table in any of the layouts that forEachRow reads
+// tables with LAYOUT PATTERN are checked once the tables they refer to are known to be valid
+static
+void checkTable(
+   Document&          d,
+   const std::string& name,
+   const Value&       table,
+   bool               patterns
+   )
+{
+   std::string path = "DATA." + name;
+   const Schema& schema = getSchema(d, name);
+   const std::vector<std::string>& keys = schema.keys;
+   const std::vector<std::string>& other = schema.other;
+
+   if( table.IsArray() )
+   {
+      if( patterns )
+         return;
+      for( SizeType r = 0; r < table.Size(); ++r )
+      {
+         auto& row = table[r];
+         bool ok = row.IsObject();
+         for( size_t k = 0; k < keys.size() && ok; ++k )
+            ok = row.HasMember(keys[k]) && row[keys[k]].IsString();
+         for( size_t o = 0; o < other.size() && ok; ++o )
+            ok = !row.HasMember(other[o]) || row[other[o]].IsNumber();
+         if( !ok )
+         {
+            reportError(path + "[" + std::to_string(r) + "]", "not a row object with string keys and number values");
+            return;
+         }
+      }
+      return;
+   }
+
+   if( !table.IsObject() )
+   {
+      reportError(path, "neither an array nor an object");
+      return;
+   }
+
+   std::string layout;
+   if( table.HasMember("LAYOUT") )
+   {
+      if( !checkString(table, "LAYOUT", path) )
+         return;
+      layout = table["LAYOUT"].GetString();
+   }
+   if( (layout == "PATTERN") != patterns )
+      return;
+
+   if( layout == "SHARDED" )
+   {
+      // rows were checked when the JSON-Lines files were parsed
+      if( !table.HasMember("SHARDS") || !table["SHARDS"].IsArray() )
+      {
+         reportError(path + ".SHARDS", "missing or not an array");
+         return;
+      }
+      for( Value::ConstValueIterator itr = table["SHARDS"].Begin(); itr != table["SHARDS"].End(); ++itr )
+         if( !itr->IsString() || shards.count(itr->GetString()) == 0 || !shards[itr->GetString()].ok )
+            reportError(path + ".SHARDS", "not a list of JSON-Lines files that could be read");
+      return;
+   }
+
+   if( layout == "BINARY" )
+   {
+      if( !binarydata.isOpen() )
+      {
+         reportError(path, "binary table, but PROBLEM has no DATA_FILE");
+         return;
+      }
+      if( !table.HasMember("TABLE") || !table["TABLE"].IsUint() || table["TABLE"].GetUint() >= binarydata.ntables() )
+      {
+         reportError(path + ".TABLE", "not a table of the binary DATA file");
+         return;
+      }
+      uint32_t t = table["TABLE"].GetUint();
+      const MosdexBinTocEntry& toc = binarydata.table(t);
+      if( toc.nkeys != keys.size() )
+      {
+         reportError(path, "binary table has " + std::to_string(toc.nkeys) + " key columns, declared are " + std::to_string(keys.size()));
+         return;
+      }
+      if( !table.HasMember("VALUES") || !table["VALUES"].IsArray() || table["VALUES"].Size() != toc.nvalues )
+      {
+         reportError(path + ".VALUES", "not an array of the " + std::to_string(toc.nvalues) + " value columns of the binary table");
+         return;
+      }
+      for( Value::ConstValueIterator itr = table["VALUES"].Begin(); itr != table["VALUES"].End(); ++itr )
+         if( !itr->IsString() )
+            reportError(path + ".VALUES", "not an array of strings");
+
+      // UEL codes are used as offsets into the labels
+      for( uint32_t k = 0; k < toc.nkeys; ++k )
+      {
+         const uint32_t* col = binarydata.keyColumn(t, k);
+         for( uint64_t r = 0; r < toc.nrows; ++r )
+            if( col[r] >= binarydata.nuels() )
+            {
+               reportError(path, "row " + std::to_string(r) + " has an invalid label code in key column " + keys[k]);
+               return;
+            }
+      }
+      return;
+   }
+
+   // value columns, at the top level or in COLUMNS
+   auto checkValues = [&](uint64_t nrows)
+   {
+      for( auto& o : other )
+      {
+         if( table.HasMember(o) )
+            checkValueColumn(table[o], nrows, path + "." + o);
+         else if( table.HasMember("COLUMNS") && table["COLUMNS"].IsObject() && table["COLUMNS"].HasMember(o) )
+            checkValueColumn(table["COLUMNS"][o], nrows, path + ".COLUMNS." + o);
+      }
+   };
+
+   if( layout == "DENSE" )
+   {
+      if( !table.HasMember("AXES") || !table["AXES"].IsObject() )
+      {
+         reportError(path + ".AXES", "missing or not an object");
+         return;
+      }
+      auto& axes = table["AXES"];
+      uint64_t nrows = 1;
+      for( auto& key : keys )
+      {
+         bool ok = axes.HasMember(key) && axes[key].IsArray();
+         for( SizeType i = 0; ok && i < axes[key].Size(); ++i )
+            ok = axes[key][i].IsString();
+         if( !ok )
+         {
+            reportError(path + ".AXES." + key, "missing or not an array of labels");
+            return;
+         }
+         nrows *= axes[key].Size();
+      }
+      checkValues(nrows);
+      return;
+   }
+
+   if( layout == "PATTERN" )
+   {
+      // the chain of pattern tables has to end in a table with its own labels
+      std::string patname = name;
+      for( size_t n = 0; ; ++n )
+      {
+         const Value& pat = d["DATA"][patname];
+         if( !pat.IsObject() || !pat.HasMember("LAYOUT") || pat["LAYOUT"] != "PATTERN" )
+            break;
+         if( n > d["DATA"].MemberCount() || !pat.HasMember("PATTERN") || !pat["PATTERN"].IsString()
+            || !d["DATA"].HasMember(pat["PATTERN"].GetString()) || !d["INPUT_DATA_MODEL"].HasMember(pat["PATTERN"].GetString()) )
+         {
+            reportError(path + ".PATTERN", "does not lead to a DATA table with labels");
+            return;
+         }
+         patname = pat["PATTERN"].GetString();
+         if( getSchema(d, patname).keys.size() != keys.size() )
+         {
+            reportError(path + ".PATTERN", "DATA table " + patname + " has a different number of key columns");
+            return;
+         }
+      }
+
+      uint64_t nrows = 0;
+      std::string first = table["PATTERN"].GetString();
+      forEachRow(d, d["DATA"][first], getSchema(d, first).keys, std::vector<std::string>(),
+         [&](const std::vector<const char*>&, const std::vector<double>&) { ++nrows; });
+      checkValues(nrows);
+      return;
+   }
+
+   if( !layout.empty() )
+   {
+      reportError(path + ".LAYOUT", "unknown layout " + layout);
+      return;
+   }
+
+   // columnar, with labels or indices into DICTIONARY
+   if( !table.HasMember("ROWS") || !table["ROWS"].IsUint64() || !table.HasMember("COLUMNS") || !table["COLUMNS"].IsObject() )
+   {
+      reportError(path, "ROWS or COLUMNS missing or of wrong type");
+      return;
+   }
+   uint64_t nrows = table["ROWS"].GetUint64();
+   SizeType ndict = 0;
+   if( table.HasMember("DICTIONARY") )
+   {
+      auto& dict = table["DICTIONARY"];
+      bool ok = dict.IsArray();
+      for( SizeType i = 0; ok && i < dict.Size(); ++i )
+         ok = dict[i].IsString();
+      if( !ok )
+      {
+         reportError(path + ".DICTIONARY", "not an array of labels");
+         return;
+      }
+      ndict = dict.Size();
+   }
+
+   auto& columns = table["COLUMNS"];
+   for( auto& key : keys )
+   {
+      if( !columns.HasMember(key) || !columns[key].IsArray() || columns[key].Size() != nrows )
+      {
+         reportError(path + ".COLUMNS." + key, "not an array of " + std::to_string(nrows) + " labels");
+         return;
+      }
+      auto& col = columns[key];
+      for( SizeType r = 0; r < col.Size(); ++r )
+         if( !col[r].IsString() && !(col[r].IsUint() && col[r].GetUint() < ndict) )
+         {
+            reportError(path + ".COLUMNS." + key + "[" + std::to_string(r) + "]", "neither a label nor an index into DICTIONARY");
+            return;
+         }
+   }
+   checkValues(nrows);
+}
+
+// checks the selected DATA tables, in one pass over their rows, and that the tables referred to are present
+// returns false on error
+static
+bool checkData(
+   Document& d
+   )
+{
+   auto& data = d["DATA"];
+
+   for( auto& ref : tablerefs )
+      if( isSelected(ref.first) && !data.HasMember(ref.first) )
+         reportError(ref.second, "DATA table " + ref.first + " is missing");
+
+   for( int patterns = 0; patterns <= 1 && nerrors == 0; ++patterns )
+      for( Value::ConstMemberIterator itr = data.MemberBegin(); itr != data.MemberEnd(); ++itr )
+      {
+         std::string name = itr->name.GetString();
+         if( !isSelected(name) )
+            continue;
+         if( !d["INPUT_DATA_MODEL"].HasMember(name) )
+         {
+            if( !patterns )
+               reportError("DATA." + name, "not declared in INPUT_DATA_MODEL");
+            continue;
+         }
+         checkTable(d, name, itr->value, patterns);
+      }
+
+   if( nerrors > MAXREPORTED )
+      std::cerr << nerrors - MAXREPORTED << " more errors" << std::endl;
+
+   return nerrors == 0;
+}
+
+// parses the value of a member from a byte range [begin, end) of a file and adds it to parent
+// begin is right after the key of the member, as recorded by gams2mosdex -index
+static
+bool loadRange(
+   FILE*       fp,
+   Document&   d,
+   Value&      parent,
+   const char* name,
+   uint64_t    begin,
+   uint64_t    end
+   )
+{
+   assert(begin <= end);
+
+   std::vector<char> buffer(end - begin);
+   if( fseeko(fp, (off_t)begin, SEEK_SET) != 0 || fread(buffer.data(), 1, buffer.size(), fp) != buffer.size() )
+   {
+      std::cerr << "Could not read " << name << " at offset " << begin << std::endl;
+      return false;
+   }
+
+   // skip separator between key and value
+   size_t start = 0;
+   while( start < buffer.size() && (isspace(buffer[start]) || buffer[start] == ':') )
+      ++start;
+
+   // parse with the allocator of d, so the value can be moved into d
+   Document part(&d.GetAllocator());
+   if( part.Parse(buffer.data() + start, buffer.size() - start).HasParseError() )
+   {
+      std::cerr << "Error(offset " << begin + start + part.GetErrorOffset() << "): " << GetParseError_En(part.GetParseError()) << std::endl;
+      return false;
+   }
+
+   Value key(name, d.GetAllocator());
+   parent.AddMember(key, part, d.GetAllocator());
+
+   return true;
+}
+
+// whether each member of ranges is a [begin, end] pair of offsets within a file of the given size
+static
+bool validRanges(
+   const Value& ranges,
+   uint64_t     filesize
+   )
+{
+   if( !ranges.IsObject() )
+      return false;
+
+   for( Value::ConstMemberIterator itr = ranges.MemberBegin(); itr != ranges.MemberEnd(); ++itr )
+   {
+      const Value& range = itr->value;
+      if( !range.IsArray() || range.Size() != 2 || !range[0].IsUint64() || !range[1].IsUint64() )
+         return false;
+      if( range[0].GetUint64() > range[1].GetUint64() || range[1].GetUint64() > filesize )
+         return false;
+   }
+   return true;
+}
+
+// builds a document from the sections needed for the selection, using the index written by gams2mosdex -index
+// returns 1 on success, 0 if the index cannot be used, -1 on error
+static
+int loadIndexed(
+   const char*  infile,
+   const Value& index,
+   Document&    d
+   )
+{
+   FILE* fp = fopen(infile, "rb");
+   if( fp == NULL )
+      return 0;
+
+   // index has to be for this file, with offsets within it
+   struct stat st;
+   if( fstat(fileno(fp), &st) != 0 || !index.IsObject() || !index.HasMember("FILE_SIZE") || !index["FILE_SIZE"].IsUint64()
+      || index["FILE_SIZE"].GetUint64() != (uint64_t)st.st_size
+      || !index.HasMember("SECTIONS") || !validRanges(index["SECTIONS"], (uint64_t)st.st_size)
+      || !index.HasMember("DATA") || !validRanges(index["DATA"], (uint64_t)st.st_size) )
+   {
+      std::cerr << "Index does not match " << infile << ", reading whole file" << std::endl;
+      fclose(fp);
+      return 0;
+   }
+
+   d.SetObject();
+
+   bool ok = true;
+   auto& sections = index["SECTIONS"];
+   for( Value::ConstMemberIterator itr = sections.MemberBegin(); itr != sections.MemberEnd() && ok; ++itr )
+   {
+      if( itr->name == "DATA" )
+         continue;
+      ok = loadRange(fp, d, d, itr->name.GetString(), itr->value[0].GetUint64(), itr->value[1].GetUint64());
+   }
+
+   // tables of a delta export may come from its base, which has to be read completely
+   if( ok && d.HasMember("PROBLEM") && d["PROBLEM"].HasMember("BASE") )
+   {
+      fclose(fp);
+      d.SetObject();
+      return 0;
+   }
+
+   Value data(kObjectType);
+   Value datakey("DATA", d.GetAllocator());
+   d.AddMember(datakey, data, d.GetAllocator());
+
+   ok = ok && resolveStructure(d, infile) && checkStructure(d);
+   if( ok )
+      expandSelection(d);
+
+   // load selected tables, then the tables they take key labels from, until nothing is added
+   auto& tables = index["DATA"];
+   do
+   {
+      for( Value::ConstMemberIterator itr = tables.MemberBegin(); itr != tables.MemberEnd() && ok; ++itr )
+      {
+         if( !isSelected(itr->name.GetString()) || d["DATA"].HasMember(itr->name.GetString()) )
+            continue;
+         ok = loadRange(fp, d, d["DATA"], itr->name.GetString(), itr->value[0].GetUint64(), itr->value[1].GetUint64());
+      }
+   }
+   while( ok && addPatternTables(d) );
+
+   fclose(fp);
+
+   return ok ? 1 : -1;
+}
+
+const std::vector<std::string>& symbolKeys(
+   Document&    d,
+   const Value& sym
+   )
+{
+   static const std::vector<std::string> none;
+
+   if( sym["INDEX"] == "self" )
+      return none;
+   return getSchema(d, sym["INDEX"].GetString()).keys;
+}
+
+void forEachEntry(
+   Document&                       d,
+   const Value&                    sym,
+   const std::vector<std::string>& other,
+   const RowCallback&              f
+   )
+{
+   if( sym["INDEX"] == "self" )
+   {
+      // as written by gams2mosdex -structure: a table without key columns and a single row
+      if( !other.empty() )
+         forEachRow(d, d["DATA"][sym["NAME"]], std::vector<std::string>(), other, f);
+      else
+         f(std::vector<const char*>(), std::vector<double>(other.size(), NOVALUE));
+      return;
+   }
+
+   forEachRow(d, d["DATA"][sym["INDEX"]], symbolKeys(d, sym), other, f);
+}
+
+// a LOWER, UPPER, or RHS of a symbol: a number, or "<symbol>.<col>" for a value column of its index table
+class ValueSpec
+{
+public:
+   double value = NOVALUE;
+
+   // position of the column in the value columns passed to forEachEntry, or -1 for a number
+   int pos = -1;
+
+   // adds the column to other if the value is given by one
+   void parse(
+      const Value&              v,
+      std::vector<std::string>& other
+      )
+   {
+      if( v.IsNumber() )
+      {
+         value = v.GetDouble();
+         return;
+      }
+
+      const char* str = v.GetString();
+      char* end;
+      value = strtod(str, &end);
+      if( end != str && *end == '\0' )
+         return;
+
+      // FIXME assumes that the part before the '.' is the symbol itself
+      pos = (int)other.size();
+      other.push_back(strchr(str, '.') + 1);
+   }
+
+   // value for an entry, NOVALUE if not given
+   double get(
+      const std::vector<double>& vals
+      ) const
+   {
+      return pos >= 0 ? vals[pos] : value;
+   }
+};
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+void forEachVariableEntry(
+   Document&               d,
+   const Value&            var,
+   const VariableCallback& f
+   )
+{
+   char type = 'C';
+   if( var.HasMember("TYPE") && strcasecmp(var["TYPE"].GetString(), "binary") == 0 )
+      type = 'B';
+   else if( var.HasMember("TYPE") && strcasecmp(var["TYPE"].GetString(), "integer") == 0 )
+      type = 'I';
+
+   std::vector<std::string> other;
+   ValueSpec lower;
+   ValueSpec upper;
+   if( var.HasMember("BOUNDS") )
+   {
+      auto& bounds = var["BOUNDS"];
+      if( bounds.HasMember("LOWER") )
+         lower.parse(bounds["LOWER"], other);
+      if( bounds.HasMember("UPPER") )
+         upper.parse(bounds["UPPER"], other);
+   }
+
+   // gams2mosdex leaves out bounds that are 0 and 1 for binaries and infinite else
+   forEachEntry(d, var, other, [&](const std::vector<const char*>& labels, const std::vector<double>& vals)
+      {
+         double lb = lower.get(vals);
+         double ub = upper.get(vals);
+         if( std::isnan(lb) )
+            lb = type == 'B' ? 0.0 : -INF;
+         if( std::isnan(ub) )
+            ub = type == 'B' ? 1.0 : INF;
+
+         f(labels, type, lb, ub);
+      });
+}
+
+void forEachConstraintEntry(
+   Document&                 d,
+   const Value&              con,
+   const ConstraintCallback& f
+   )
+{
+   std::vector<std::string> other;
+   ValueSpec lower;
+   ValueSpec upper;
+   if( con.HasMember("RHS") )
+   {
+      // the RHS is the lower bound, the upper bound, or both
+      ValueSpec rhs;
+      rhs.parse(con["RHS"], other);
+      if( con["SENSE"] != "<=" )
+         lower = rhs;
+      if( con["SENSE"] != ">=" )
+         upper = rhs;
+   }
+   else if( con.HasMember("BOUNDS") )
+   {
+      auto& bounds = con["BOUNDS"];
+      if( bounds.HasMember("LOWER") )
+         lower.parse(bounds["LOWER"], other);
+      if( bounds.HasMember("UPPER") )
+         upper.parse(bounds["UPPER"], other);
+   }
+
+   forEachEntry(d, con, other, [&](const std::vector<const char*>& labels, const std::vector<double>& vals)
+      {
+         double lb = lower.get(vals);
+         double ub = upper.get(vals);
+
+         // an RHS that is not given for an entry is 0
+         if( con.HasMember("RHS") )
+         {
+            if( std::isnan(lb) && lower.pos >= 0 )
+               lb = 0.0;
+            if( std::isnan(ub) && upper.pos >= 0 )
+               ub = 0.0;
+         }
+
+         f(labels, std::isnan(lb) ? -INF : lb, std::isnan(ub) ? INF : ub);
+      });
+}
+
+// labels of the variable entries that have the same labels in the conditioned domains, one entry after the other
+class EntryGroup
+{
+public:
+   size_t nentries = 0;
+   std::vector<std::string> labels;
+};
+
+void forEachCoefficient(
+   Document&                  d,
+   const Value&               coef,
+   const Value&               con,
+   const Value&               var,
+   const CoefficientCallback& f
+   )
+{
+   const std::vector<std::string>& condom = symbolKeys(d, con);
+   const std::vector<std::string>& vardom = symbolKeys(d, var);
+
+   // constraint domain that each variable domain is conditioned on, or -1
+   std::vector<int> vartocon(vardom.size(), -1);
+   if( coef.HasMember("CONDITION") )
+      for( auto& p : parseCondition(coef["CONDITION"].GetString()) )
+      {
+         int v = (int)(std::find(vardom.begin(), vardom.end(), p.first) - vardom.begin());
+         int e = (int)(std::find(condom.begin(), condom.end(), p.second) - condom.begin());
+         assert(v < (int)vardom.size() && e < (int)condom.size());
+         vartocon[v] = e;
+      }
+
+   std::vector<const char*> conlabels(condom.size());
+   std::vector<const char*> varlabels(vardom.size());
+
+   auto& entries = coef["ENTRIES"];
+   if( entries.IsString() )
+   {
+      // "table.col": constraint domains and unconditioned variable domains are keys of the table
+      std::string entriesstr = entries.GetString();
+      std::string::size_type dot = entriesstr.find('.');
+      std::string table(entriesstr, 0, dot);
+      std::vector<std::string> other(1, std::string(entriesstr, dot+1));
+      const std::vector<std::string>& tablekeys = getSchema(d, table).keys;
+
+      std::vector<size_t> conpos;
+      for( auto& e : condom )
+         conpos.push_back(std::find(tablekeys.begin(), tablekeys.end(), e) - tablekeys.begin());
+      std::vector<size_t> varpos;
+      for( size_t v = 0; v < vardom.size(); ++v )
+         varpos.push_back(vartocon[v] >= 0 ? conpos[vartocon[v]] : std::find(tablekeys.begin(), tablekeys.end(), vardom[v]) - tablekeys.begin());
+
+      forEachRow(d, d["DATA"][table], tablekeys, other, [&](const std::vector<const char*>& labels, const std::vector<double>& vals)
+         {
+            if( std::isnan(vals[0]) )
+               return;
+            for( size_t e = 0; e < condom.size(); ++e )
+               conlabels[e] = labels[conpos[e]];
+            for( size_t v = 0; v < vardom.size(); ++v )
+               varlabels[v] = labels[varpos[v]];
+            f(conlabels, varlabels, vals[0]);
+         });
+      return;
+   }
+
+   // a number for all pairs of constraint and variable entries that satisfy the condition:
+   // variable entries are grouped by their labels in the conditioned domains, then looked up for each constraint entry
+   double value = entries.GetDouble();
+
+   std::unordered_map<std::string, EntryGroup> bycondition;
+   forEachEntry(d, var, std::vector<std::string>(), [&](const std::vector<const char*>& labels, const std::vector<double>&)
+      {
+         std::string key;
+         for( size_t v = 0; v < vardom.size(); ++v )
+            if( vartocon[v] >= 0 )
+               (key += labels[v]) += '\1';
+         EntryGroup& group = bycondition[key];
+         group.labels.insert(group.labels.end(), labels.begin(), labels.end());
+         ++group.nentries;
+      });
+
+   forEachEntry(d, con, std::vector<std::string>(), [&](const std::vector<const char*>& labels, const std::vector<double>&)
+      {
+         std::string key;
+         for( size_t v = 0; v < vardom.size(); ++v )
+            if( vartocon[v] >= 0 )
+               (key += labels[vartocon[v]]) += '\1';
+         auto it = bycondition.find(key);
+         if( it == bycondition.end() )
+            return;
+
+         const EntryGroup& group = it->second;
+         for( size_t n = 0; n < group.nentries; ++n )
+         {
+            for( size_t v = 0; v < vardom.size(); ++v )
+               varlabels[v] = group.labels[n * vardom.size() + v].c_str();
+            f(labels, varlabels, value);
+         }
+      });
+}
+
+void unloadMosdex()
+{
+   schemas.clear();
+   symbolindex.clear();
+   shards.clear();
+   if( binarydata.isOpen() )
+      binarydata.close();
+   tablerefs.clear();
+   nerrors = 0;
+   structurefile = NULL;
+}
+
+// FIXME assumes very particular format
+std::vector<std::pair<std::string, std::string> > parseCondition(
+   const std::string& cond
+   )
+{
+   std::vector<std::pair<std::string, std::string> > pairs;
+
+   size_t pos = 0;
+   while( pos < cond.size() )
+   {
+      size_t andpos = cond.find(" and ", pos);
+      if( andpos == std::string::npos )
+         andpos = cond.size();
+
+      std::string eq(cond, pos, andpos - pos);
+      size_t seppos = eq.find(" == ");
+      assert(seppos != std::string::npos);
+
+      std::string first(eq, 0, seppos);
+      std::string second(eq, seppos+4);
+
+      first = std::string(first, first.find(".")+1);
+      second = std::string(second, second.find(".")+1);
+      pairs.push_back(std::make_pair(first, second));
+
+      pos = andpos + 5;
+   }
+
+   return pairs;
+}
+
+bool loadMosdex(
+   Document&   d,
+   const char* infile,
+   Compression compression,
+   unsigned    nthreads,
+   const char* structure
+   )
+{
+   structurefile = structure;
+
+   // with a selection, parse only the needed sections and tables if there is an index
+   int loaded = 0;
+   std::string indexfile = std::string(infile) + ".idx";
+   struct stat st;
+   if( !selection.empty() && compression == COMPRESSION_NONE && stat(indexfile.c_str(), &st) == 0 )
+   {
+      MosdexInputStream is;
+      Document index;
+      if( is.open(indexfile.c_str(), COMPRESSION_NONE) && !index.ParseStream(is).HasParseError() && index.IsObject() )
+         loaded = loadIndexed(infile, index, d);
+   }
+
+   if( loaded < 0 )
+      return false;
+
+   if( loaded == 0 )
+   {
+      MosdexInputStream is;
+      if( !is.open(infile, compression) )
+         return false;
+
+      if( d.ParseStream(is).HasParseError() )
+      {
+         std::cerr << "Error(offset " << d.GetErrorOffset() << "): " << GetParseError_En(d.GetParseError()) << std::endl;
+         return false;
+      }
+
+      if( is.failed() )
+      {
+         std::cerr << "Error reading " << infile << std::endl;
+         return false;
+      }
+
+      is.close();
+
+      if( !resolveStructure(d, infile) || !checkStructure(d) || !resolveBase(d, infile) )
+         return false;
+
+      expandSelection(d);
+      while( addPatternTables(d) )
+         ;
+   }
+
+   // binary DATA file is given relative to the directory of the document
+   if( d.HasMember("PROBLEM") && d["PROBLEM"].HasMember("DATA_FILE") )
+   {
+      std::string datafile = relativeTo(infile, d["PROBLEM"]["DATA_FILE"].GetString());
+      if( !binarydata.open(datafile.c_str()) )
+         return false;
+   }
+
+   return loadShards(d, infile, nthreads) && checkData(d);
+}
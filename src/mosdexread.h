@@ -0,0 +1,153 @@
+#ifndef MOSDEXREAD_H
+#define MOSDEXREAD_H
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+
+#define RAPIDJSON_HAS_STDSTRING 1
+#include "rapidjson/document.h"
+
+#include "mosdexio.h"
+
+// reading of MOSDEX documents as gams2mosdex writes them, for the tools that convert them further
+
+// columns of a DATA table as declared in INPUT_DATA_MODEL, resolved once per table, see getSchema
+class Schema
+{
+public:
+   // key columns, in declaration order, without the leading '*'
+   std::vector<std::string> keys;
+
+   // value columns, sorted
+   std::vector<std::string> other;
+
+   // key columns joined by ", "
+   std::string domstr;
+
+   // whether the table has no value columns and is thus written as a set
+   bool isset = true;
+};
+
+// schema of a DATA table from its declaration, if not resolved before
+const Schema& addSchema(
+   const std::string&      table,
+   const rapidjson::Value& decl
+);
+
+// schema of a DATA table
+const Schema& getSchema(
+   rapidjson::Document& d,
+   const std::string&   table
+);
+
+// schema of the index table of a variable ("VARIABLES") or constraint ("CONSTRAINTS")
+const Schema& getSymbolSchema(
+   rapidjson::Document& d,
+   const std::string&   entity,
+   const std::string&   name
+);
+
+// variables, constraints, and DATA tables to convert; everything if empty
+extern std::set<std::string> selection;
+
+bool isSelected(
+   const std::string& name
+);
+
+// marks a value that is not given for a row of a DATA table
+static const double NOVALUE = std::numeric_limits<double>::quiet_NaN();
+
+// callback for rows of a DATA table: labels of the key columns, values of the value columns (NOVALUE if not given)
+typedef std::function<void(const std::vector<const char*>&, const std::vector<double>&)> RowCallback;
+
+// calls f for each row of a DATA table, whatever layout gams2mosdex used for it:
+// - an array of row objects
+// - columnar: { "ROWS": n, "COLUMNS": { col: [ ... ] }, "DICTIONARY": [ ... ] }
+// - dense: { "LAYOUT": "DENSE", "AXES": { key: [ ... ] }, col: [ ... ] } with values over the product of the axes
+// - pattern: { "LAYOUT": "PATTERN", "PATTERN": table, col: [ ... ] } with key labels from the rows of another table
+// - binary: { "LAYOUT": "BINARY", "TABLE": t, "VALUES": [ col, ... ] } with the columns in the binary DATA file
+// - sharded: { "LAYOUT": "SHARDED", "ROWS": n, "SHARDS": [ file, ... ] } with rows in JSON-Lines files, see loadShards
+void forEachRow(
+   rapidjson::Document&            d,
+   const rapidjson::Value&         table,
+   const std::vector<std::string>& keys,
+   const std::vector<std::string>& other,
+   const RowCallback&              f
+);
+
+// key columns of the index table of a variable or constraint, none for INDEX "self"
+const std::vector<std::string>& symbolKeys(
+   rapidjson::Document&    d,
+   const rapidjson::Value& sym
+);
+
+// calls f for each entry of a variable or constraint with the values of the value columns other of its index table,
+// or once without labels for INDEX "self", with the values from the DATA table named as the symbol if other is not empty
+void forEachEntry(
+   rapidjson::Document&            d,
+   const rapidjson::Value&         sym,
+   const std::vector<std::string>& other,
+   const RowCallback&              f
+);
+
+// callback for entries of a variable: labels, type ('C', 'I', or 'B'), lower and upper bound
+typedef std::function<void(const std::vector<const char*>&, char, double, double)> VariableCallback;
+
+// calls f for each entry of a variable, with bounds that are not given as gams2mosdex leaves them out
+void forEachVariableEntry(
+   rapidjson::Document&    d,
+   const rapidjson::Value& var,
+   const VariableCallback& f
+);
+
+// callback for entries of a constraint: labels, lower and upper bound of the row, infinite if not bounded
+typedef std::function<void(const std::vector<const char*>&, double, double)> ConstraintCallback;
+
+// calls f for each entry of a constraint, with bounds from RHS and SENSE, or from BOUNDS
+void forEachConstraintEntry(
+   rapidjson::Document&      d,
+   const rapidjson::Value&   con,
+   const ConstraintCallback& f
+);
+
+// callback for coefficients: labels of the constraint entry, labels of the variable entry, value
+typedef std::function<void(const std::vector<const char*>&, const std::vector<const char*>&, double)> CoefficientCallback;
+
+// calls f for each coefficient of a block of COEFFICIENTS with constraint (or objective) con and variable var,
+// taking the values from its table, or expanding a single value over the entries that satisfy its CONDITION
+void forEachCoefficient(
+   rapidjson::Document&       d,
+   const rapidjson::Value&    coef,
+   const rapidjson::Value&    con,
+   const rapidjson::Value&    var,
+   const CoefficientCallback& f
+);
+
+// pairs (variable domain, constraint domain) of a CONDITION "var.vdom == con.edom and ..." of a coefficient block
+std::vector<std::pair<std::string, std::string> > parseCondition(
+   const std::string& cond
+);
+
+// reads infile into d, with only the parts that the selection needs if there is an index written by gams2mosdex -index,
+// takes the sections of a data-only export from its structure file (structure if not NULL, else the one it refers to),
+// takes DATA tables of a delta export from its base, and opens the binary and JSON-Lines DATA files it refers to
+// JSON-Lines files are parsed with up to nthreads threads
+// the document is validated on the way: sections, members and their types, the tables and columns that symbols and
+// coefficient blocks refer to, and the rows of the selected DATA tables; what is asserted after that is thus guaranteed,
+// also in builds with NDEBUG
+// returns false on error, after reporting it with its location in the document
+bool loadMosdex(
+   rapidjson::Document& d,
+   const char*          infile,
+   Compression          compression,
+   unsigned             nthreads,
+   const char*          structure = NULL
+);
+
+// forgets the schemas, DATA files, and state of the document loaded last, so that another one can be loaded
+void unloadMosdex();
+
+#endif